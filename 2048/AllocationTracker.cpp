@@ -0,0 +1,88 @@
+#include "AllocationTracker.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <new>
+
+
+#ifdef TRACK_ALLOCATIONS
+
+// the other threads load, save and copy snapshots as they please, only the frame's own thread is checked
+static thread_local uint32_t allocations = 0;
+
+
+static void* countedAlloc(size_t size)
+{
+	++allocations;
+
+	if (void* ptr = malloc(size ? size : 1))
+		return ptr;
+	throw std::bad_alloc();
+}
+
+void* operator new(size_t size)
+{
+	return countedAlloc(size);
+}
+
+void* operator new[](size_t size)
+{
+	return countedAlloc(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+	free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept
+{
+	free(ptr);
+}
+
+#endif
+
+
+
+thread_local uint32_t AllocationTracker::frameStart = 0;
+
+thread_local uint32_t AllocationTracker::frame = 0;
+
+
+void AllocationTracker::beginFrame()
+{
+	frameStart = getAllocationCount();
+	++frame;
+}
+
+void AllocationTracker::endFrame(bool steady)
+{
+	uint32_t count = getAllocationCount() - frameStart;
+
+	if (!steady || !count)
+		return;
+
+	printf("Frame %u made %u heap allocations\n", frame, count);
+
+#ifdef ABORT_ON_FRAME_ALLOCATION
+	abort();
+#endif
+}
+
+uint32_t AllocationTracker::getAllocationCount()
+{
+#ifdef TRACK_ALLOCATIONS
+	return allocations;
+#else
+	return 0;
+#endif
+}
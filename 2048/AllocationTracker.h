@@ -0,0 +1,29 @@
+#pragma once
+#include <stdint.h>
+
+
+
+// with TRACK_ALLOCATIONS defined the global operator new and delete count every allocation per thread,
+// otherwise nothing is counted and frames are never reported, defining ABORT_ON_FRAME_ALLOCATION as well
+// turns a report into a crash, so an allocating frame can't go unnoticed,
+// a frame only sees the allocations of the thread that begins and ends it
+class AllocationTracker
+{
+public:
+
+	static void beginFrame();
+
+	// reports the frame if it had to be allocation-free and wasn't
+	static void endFrame(bool steady);
+
+
+	// made by the calling thread since it started
+	static uint32_t getAllocationCount();
+
+private:
+
+	// each thread brackets its own frames
+	static thread_local uint32_t frameStart;
+
+	static thread_local uint32_t frame;
+};
@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <time.h>
 #include "Application.h"
+#include "AllocationTracker.h"
 
 
 GameSave::GameSave(size_t saveTime, size_t worldTime, size_t points) : worldTime(worldTime), points(points), saveTime(saveTime)
@@ -10,61 +11,359 @@ GameSave::GameSave(size_t saveTime, size_t worldTime, size_t points) : worldTime
 
 
 
-Application::Application() : win({ Vec2u(720, 560), "Pawel Glomski 172026" })
+Application::Application(int argc, char** argv) : win(parseArguments(argc, argv))
 {
-	if (board.loadFrom("shape"))
+	VirtualClock* virtualClock = nullptr;
+	Vector<Clock::TimePoint_t> script;
+	size_t boardSize = 0;
+
+	for (int i = 1; i < argc; ++i)
+		if (!strcmp(argv[i], "-turbo-every") && i + 1 < argc)
+			turboEvery = uint32_t(atoi(argv[++i]));
+		else if (!strcmp(argv[i], "-virtual-clock") && i + 1 < argc && !virtualClock)
+			virtualClock = new VirtualClock(maxVal(uint32_t(atoi(argv[++i])), 1u));
+		else if (!strcmp(argv[i], "-virtual-clock-script") && i + 1 < argc)
+			parseScript(argv[++i], script);
+		else if (!strcmp(argv[i], "-board-size") && i + 1 < argc)
+			boardSize = size_t(atoi(argv[++i]));
+		else if (!strcmp(argv[i], "-quit-after") && i + 1 < argc)
+			quitAfter = uint32_t(atoi(argv[++i]));
+		else if (!strcmp(argv[i], "-autoplay"))
+			autoPlay = true;
+
+	if (virtualClock)
+	{
+		virtualClock->setScript(script);
+		clock = virtualClock;
+	}
+	else
+		clock = new SimulationClock();
+
+	if (boardSize)
+	{
+		board.setDefaultShape(boardSize);
 		state = State::Playing;
+	}
+	else if (board.loadFrom("shape") || virtualClock)
+		state = State::Playing;
+
+	// a run on the virtual clock has to play the same every time, so it neither resumes nor leaves a journal
+	if (virtualClock)
+		journal.disable();
+	else if (Journal::canResume())
+	{
+		resumeFallback = state;
+		showMessage("Resume the last game?", MessageBox::Type::Question);
+	}
+	else if (state == State::Playing)
+		journal.checkpoint(board, points, 0);
+
+	boardView.setPosition(Vec2i(WinSize / 2u));
+
+	// a turbo game publishes a state per refresh, the frames are paced on the real clock even with a virtual one
+	uint32_t refreshRate = win.getRefreshRate();
+	clock->setFrameRate(refreshRate);
+	frameClock.setFrameRate(refreshRate);
+
+	simulationSeed = unsigned(rand());
+
+	simulationWake = SDL_CreateSemaphore(0);
+	renderWake = SDL_CreateSemaphore(0);
 
-	board.setPosition(Vec2i(WinSize / 2u));
+	// the first frame has something to show before the simulation starts
+	publish();
+}
+
+Application::~Application()
+{
+	SDL_DestroySemaphore(renderWake);
+	SDL_DestroySemaphore(simulationWake);
+	delete clock;
+}
+
+WindowProperties Application::parseArguments(int argc, char ** argv)
+{
+	WindowProperties properties = { WinSize, "Pawel Glomski 172026" };
+
+	for (int i = 1; i < argc; ++i)
+		if (!strcmp(argv[i], "-renderer"))
+			properties.backend = RenderBackend::Renderer;
+		else if (!strcmp(argv[i], "-locked"))
+			properties.backend = RenderBackend::LockedSurface;
+		else if (!strcmp(argv[i], "-driver") && i + 1 < argc && strlen(argv[i + 1]) < sizeof(properties.renderDriver))
+			strcpy_s(properties.renderDriver, argv[++i]);
+
+	return properties;
+}
+
+void Application::parseScript(char const * list, Vector<Clock::TimePoint_t>& steps)
+{
+	// anything that isn't a number ends the list
+	while (*list)
+	{
+		char* end = nullptr;
+		unsigned long step = strtoul(list, &end, 10);
+		if (end == list)
+			break;
+
+		steps.pushBack(Clock::TimePoint_t(step));
+		list = *end == ',' ? end + 1 : end;
+	}
 }
 
 int Application::run()
 {
-	clock.restart();
+	SDL_Thread* simulation = SDL_CreateThread(simulationMain, "simulation", this);
+	SDL_Thread* renderer = SDL_CreateThread(renderMain, "render", this);
+
+	while (!SDL_AtomicGet(&renderDone))
+		forwardEvents();
+
+	SDL_WaitThread(renderer, nullptr);
+	SDL_WaitThread(simulation, nullptr);
+
+	eventLatency.print();
+	receiveLatency.print();
+	return 0;
+}
+
+void Application::forwardEvents()
+{
+	SDL_Event event;
+	bool forwarded = false;
+
+	// blocks until an event comes, then takes the rest of the queue with it
+	for (bool received = win.waitEvent(event, EventWaitTimeout); received; received = win.pollEvent(event))
+	{
+		if (event.type == SDL_QUIT)
+		{
+			SDL_AtomicSet(&quitRequested, 1);
+			forwarded = true;
+		}
+		// only the render thread cares about the window
+		else if (event.type == SDL_WINDOWEVENT)
+		{
+			SDL_AtomicSet(&windowChanged, 1);
+			wakeRenderer();
+		}
+		else
+			forwarded |= events.push(event, SDL_GetPerformanceCounter());
+	}
+
+	if (forwarded)
+		SDL_SemPost(simulationWake);
+}
+
+int Application::simulationMain(void * app)
+{
+	((Application*)app)->simulate();
+	return 0;
+}
+
+void Application::simulate()
+{
+	srand(simulationSeed);
+	clock->restart();
 
 	while (state != State::Quitting)
 	{
-		clock.nextStep();
-		
+		bool steady = state == State::Playing;
+		stepResized = false;
+		AllocationTracker::beginFrame();
+
+		// a game at rest sleeps until an event comes or the clock of the HUD ticks, a turbo game never sleeps
+		bool idle = isIdle();
+		bool turboRunning = isTurboRunning();
+		clock->waitFor(simulationWake, turboRunning ? 0 : idle ? Uint32(1000 - clock->getWorldTime() % 1000) : Uint32(SimulationStep));
+		clock->nextStep();
+
 		input();
-		
-		logic();
-		
-		display();
+
+		// a game at rest has nothing to catch up on, one step takes the input
+		if (turboRunning)
+			playTurbo();
+		else
+		{
+			if (idle)
+				simulationLag = SimulationStep;
+			else
+				simulationLag = minVal(simulationLag + clock->getDeltaTime() * (fastForward ? FastForwardFactor : 1), MaxSimulationLag);
+
+			for (; simulationLag >= SimulationStep; simulationLag -= SimulationStep)
+				logic();
+		}
+
+		updateMoveRate();
+		publish();
+
+		// a step that starts or leaves a game, or copies into boards and lists of another size, may allocate
+		AllocationTracker::endFrame(steady && !stepResized && state == State::Playing);
 	}
 
+	// a turbo game quit mid-way is resumed where it stopped, not up to a second before
+	if (unjournaledMoves)
+		checkpoint();
+}
+
+void Application::publish()
+{
+	Snapshot& next = frames.getBack();
+
+	next.state = state;
+	next.message = message;
+	next.messageType = messageType;
+	next.points = points;
+	next.worldTime = clock->getWorldTime();
+	next.animating = board.isAnimating() || moveQueueCount > 0;
+	next.simulationLag = simulationLag;
+	next.publishTime = SDL_GetPerformanceCounter();
+	next.redrawCount = redrawCount;
+	next.showLatency = showLatency;
+	next.autoPlay = autoPlay;
+	next.turbo = turbo;
+	next.autoPolicy = autoPolicy;
+	next.movesPerSecond = movesPerSecond;
+
+	for (uint32_t i = 0; i < ShiftedInputCount; ++i)
+		next.shiftedInputs[i] = shiftedInputs[i];
+	next.shiftedInputCount = shiftedInputCount;
+
+	stepResized |= next.board.copyStateFrom(board);
+
+	if (next.savesVersion != savesVersion)
+	{
+		stepResized = true;
+		next.saves = saves;
+		for (uint8_t order = 0; order < uint8_t(SaveOrder::Count); ++order)
+			next.saveIndex[order] = saveIndex[order];
+		next.savesVersion = savesVersion;
+	}
+	next.saveOrder = saveOrder;
+	next.firstVisibleSave = firstVisibleSave;
+	strcpy_s(next.inputStr, inputStr);
+
+	frames.publish();
+	wakeRenderer();
+}
+
+int Application::renderMain(void * app)
+{
+	((Application*)app)->render();
 	return 0;
 }
 
+void Application::render()
+{
+	win.createTarget();
+	frameClock.restart();
+
+	while (true)
+	{
+		AllocationTracker::beginFrame();
+
+		// wakes posted before the snapshot and the window are looked at are covered by them
+		SDL_AtomicSet(&wakePending, 0);
+		while (!SDL_SemTryWait(renderWake)) {}
+
+		if (SDL_AtomicSet(&windowChanged, 0))
+			fullRedraw = true;
+
+		// frames come at the display's rate only while something moves, a new snapshot or the window wakes the thread up
+		bool fresh = frames.acquire();
+		if (!fresh && !fullRedraw && !frames.getFront().animating && !win.isDirty())
+			SDL_SemWaitTimeout(renderWake, RenderIdleTimeout);
+		else
+			frameClock.waitForFrame();
+		frameClock.nextStep();
+
+		if (SDL_AtomicSet(&windowChanged, 0))
+			fullRedraw = true;
+		frames.acquire();
+
+		Snapshot const& frame = frames.getFront();
+		if (frame.state == State::Quitting)
+			break;
+
+		display(frame);
+
+		// the panels and a board of a new shape may allocate, a game in progress may not
+		AllocationTracker::endFrame(!viewReshaped && frame.state == State::Playing);
+	}
+
+	// the renderer goes with the thread that made it
+	win.destroyTarget();
+	SDL_AtomicSet(&renderDone, 1);
+
+	SDL_Event wake;
+	SDL_zero(wake);
+	wake.type = SDL_USEREVENT;
+	SDL_PushEvent(&wake);
+}
+
+void Application::wakeRenderer()
+{
+	if (SDL_AtomicCAS(&wakePending, 0, 1))
+		SDL_SemPost(renderWake);
+}
+
 void Application::input()
 {
 	SDL_Event event;
 
-	while (win.pollEvent(event))
+	while (events.pop(event, eventReceived))
 	{
 		messageInput(event);
 		boardSizeChoiceInput(event);
 		playingInput(event);
 		loadingInput(event);
 
-		if (event.type == SDL_QUIT)
-			state = State::Quitting;
+		// the panels are static, so they are repainted only after input
+		if (state != State::Playing && (event.type == SDL_KEYDOWN || event.type == SDL_MOUSEWHEEL))
+			++redrawCount;
 	}
+
+	if (SDL_AtomicGet(&quitRequested))
+		state = State::Quitting;
 }
 
 void Application::playingInput(SDL_Event const & event)
 {
-	if(state == State::Playing)
-		if (event.type == SDL_KEYDOWN)
-			if (event.key.keysym.sym == SDLK_LEFT) shiftDirection = Direction::Left;
-			else if (event.key.keysym.sym == SDLK_RIGHT) shiftDirection = Direction::Right;
-			else if (event.key.keysym.sym == SDLK_UP) shiftDirection = Direction::Up;
-			else if (event.key.keysym.sym == SDLK_DOWN) shiftDirection = Direction::Down;
-			else if (event.key.keysym.sym == SDLK_u) { if (board.undo()) points = prevPoints; }
-			else if (event.key.keysym.sym == SDLK_n) reset();
-			else if (event.key.keysym.sym == SDLK_ESCAPE) state = State::Quitting;
-			else if (event.key.keysym.sym == SDLK_l) { state = State::Loading; loadSaves(); }
-			else if (event.key.keysym.sym == SDLK_s) save();
+	if (state != State::Playing)
+		return;
+
+	if (event.type == SDL_KEYDOWN)
+	{
+		InputTag input;
+		input.timestamp = event.key.timestamp;
+		input.received = eventReceived;
+
+		if (event.key.keysym.sym == SDLK_LEFT) queueMove(Direction::Left, input);
+		else if (event.key.keysym.sym == SDLK_RIGHT) queueMove(Direction::Right, input);
+		else if (event.key.keysym.sym == SDLK_UP) queueMove(Direction::Up, input);
+		else if (event.key.keysym.sym == SDLK_DOWN) queueMove(Direction::Down, input);
+		else if (event.key.keysym.sym == SDLK_u) { if (board.undo()) { points = prevPoints; if (shouldJournal()) journal.recordUndo(points, clock->getWorldTime()); } }
+		else if (event.key.keysym.sym == SDLK_n) reset();
+		else if (event.key.keysym.sym == SDLK_ESCAPE) state = State::Quitting;
+		else if (event.key.keysym.sym == SDLK_l) { state = State::Loading; loadSaves(); }
+		else if (event.key.keysym.sym == SDLK_s) save();
+		else if (event.key.keysym.sym == SDLK_c) { board.resetCamera(); ++redrawCount; }
+		else if (event.key.keysym.sym == SDLK_f) fastForward = !fastForward;
+		else if (event.key.keysym.sym == SDLK_i) { showLatency = !showLatency; ++redrawCount; }
+		else if (event.key.keysym.sym == SDLK_a) { autoPlay = !autoPlay; ++redrawCount; }
+		else if (event.key.keysym.sym == SDLK_p) { autoPolicy = AutoPolicy((uint8_t(autoPolicy) + 1) % uint8_t(AutoPolicy::Count)); ++redrawCount; }
+		else if (event.key.keysym.sym == SDLK_t) { turbo = !turbo; board.setInstant(turbo); ++redrawCount; }
+	}
+	else if (event.type == SDL_MOUSEWHEEL && event.wheel.y)
+	{
+		board.zoom(event.wheel.y > 0 ? BoardZoomStep : 1.f / BoardZoomStep);
+		++redrawCount;
+	}
+	// dragging with the right button moves the board
+	else if (event.type == SDL_MOUSEMOTION && (event.motion.state & SDL_BUTTON_RMASK))
+	{
+		board.pan({ event.motion.xrel, event.motion.yrel });
+		++redrawCount;
+	}
 }
 
 void Application::boardSizeChoiceInput(SDL_Event const & event)
@@ -91,56 +390,111 @@ void Application::boardSizeChoiceInput(SDL_Event const & event)
 					inputStr[inputLen = 0] = '\0';
 
 					state = State::Playing;
+					journal.checkpoint(board, points, clock->getWorldTime());
 				}
 			}
 }
 
 void Application::loadingInput(SDL_Event const & event)
 {
-	if (state == State::Loading)
-		if (event.type == SDL_KEYDOWN)
-			if (event.key.keysym.sym >= SDLK_0 && event.key.keysym.sym <= SDLK_9)
-			{
-				inputStr[inputLen++] = '0' + (event.key.keysym.sym - SDLK_0);
-				inputStr[inputLen] = '\0';
-			}
-			else if (event.key.keysym.sym == SDLK_BACKSPACE && inputLen > 0)
-				inputStr[--inputLen] = '\0';
-			else if (event.key.keysym.sym == SDLK_ESCAPE) state = State::Playing;
-			else if (event.key.keysym.sym == SDLK_RETURN)
+	if (state != State::Loading)
+		return;
+
+	if (event.type == SDL_MOUSEWHEEL)
+		scrollSaves(-3 * event.wheel.y);
+	else if (event.type == SDL_KEYDOWN)
+	{
+		if (event.key.keysym.sym >= SDLK_0 && event.key.keysym.sym <= SDLK_9)
+		{
+			inputStr[inputLen++] = '0' + (event.key.keysym.sym - SDLK_0);
+			inputStr[inputLen] = '\0';
+		}
+		else if (event.key.keysym.sym == SDLK_BACKSPACE && inputLen > 0)
+			inputStr[--inputLen] = '\0';
+		else if (event.key.keysym.sym == SDLK_UP) scrollSaves(-1);
+		else if (event.key.keysym.sym == SDLK_DOWN) scrollSaves(1);
+		else if (event.key.keysym.sym == SDLK_PAGEUP) scrollSaves(-int32_t(visibleSaveRows()));
+		else if (event.key.keysym.sym == SDLK_PAGEDOWN) scrollSaves(int32_t(visibleSaveRows()));
+		else if (event.key.keysym.sym == SDLK_HOME) scrollSaves(-int32_t(saves.size()));
+		else if (event.key.keysym.sym == SDLK_END) scrollSaves(int32_t(saves.size()));
+		else if (event.key.keysym.sym == SDLK_t) { saveOrder = SaveOrder::SaveTime; firstVisibleSave = 0; }
+		else if (event.key.keysym.sym == SDLK_p) { saveOrder = SaveOrder::Points; firstVisibleSave = 0; }
+		else if (event.key.keysym.sym == SDLK_w) { saveOrder = SaveOrder::WorldTime; firstVisibleSave = 0; }
+		else if (event.key.keysym.sym == SDLK_ESCAPE) state = State::Playing;
+		else if (event.key.keysym.sym == SDLK_RETURN)
+		{
+			if (inputLen == 0)
+				state = State::Playing;
+			else
 			{
-				if (inputLen == 0)
-					state = State::Playing;
-				else
-				{
-					size_t idx = 0;
-					sscanf_s(inputStr, "%u", &idx);
-					load(idx - 1);
-					inputStr[inputLen = 0] = '\0';
-				}
+				size_t idx = 0;
+				sscanf_s(inputStr, "%u", &idx);
+				load(idx - 1);
+				inputStr[inputLen = 0] = '\0';
 			}
+		}
+	}
 }
 
 void Application::messageInput(SDL_Event const & event)
 {
 	if (state == State::Message)
 		if (event.type == SDL_KEYDOWN)
-			if (event.key.keysym.sym == SDLK_RETURN)
+			if (messageType == MessageBox::Type::Question)
 			{
-				if (msgBox.type == MessageBox::Type::Error)
+				if (event.key.keysym.sym == SDLK_y || event.key.keysym.sym == SDLK_n)
+				{
+					messageType = MessageBox::Type::Count;
+					resume(event.key.keysym.sym == SDLK_y);
+				}
+			}
+			else if (event.key.keysym.sym == SDLK_RETURN)
+			{
+				if (messageType == MessageBox::Type::Error)
 					state = State::Quitting;
 				else
 					state = State::Playing;
-				msgBox.type = MessageBox::Type::Count;
+				messageType = MessageBox::Type::Count;
 			}
 }
 
+void Application::showMessage(char const * text, MessageBox::Type type)
+{
+	message = text;
+	messageType = type;
+	state = State::Message;
+}
+
 void Application::reset()
 {
 	points = 0;
 	prevPoints = 0;
-	clock.restart();
+	moveQueueCount = 0;
+	clock->restart();
 	board.reset();
+	journal.checkpoint(board, points, 0);
+}
+
+void Application::resume(bool fromJournal)
+{
+	size_t worldTime = 0;
+
+	if (fromJournal && Journal::replay(board, points, worldTime))
+	{
+		prevPoints = points;
+		clock->setWorldTime(worldTime);
+		state = State::Playing;
+	}
+	else
+	{
+		// a failed replay leaves the default board behind
+		if (fromJournal)
+			board.loadFrom("shape");
+		state = resumeFallback;
+	}
+
+	if (state == State::Playing)
+		journal.checkpoint(board, points, clock->getWorldTime());
 }
 
 void Application::save()
@@ -160,10 +514,9 @@ void Application::save()
 		{
 			if (!saves.find({ now, 0,0 }, GameSave_SaveTimeCmp()))
 			{
-				fprintf_s(file, "%u %u %u\n", now, clock.getWorldTime(), points);
+				fprintf_s(file, "%u %u %u\n", now, clock->getWorldTime(), points);
 
-				msgBox.set("Saving completed");
-				state = State::Message;
+				showMessage("Saving completed");
 			}
 			fclose(file);
 			return;
@@ -171,8 +524,7 @@ void Application::save()
 		fclose(file);
 	}
 
-	msgBox.set("Saving failed", MessageBox::Type::Warning);
-	state = State::Message;
+	showMessage("Saving failed", MessageBox::Type::Warning);
 }
 
 void Application::loadSaves()
@@ -195,11 +547,19 @@ void Application::loadSaves()
 		fclose(file);
 	}
 
-	if (result != EOF)
+	for (uint8_t order = 0; order < uint8_t(SaveOrder::Count); ++order)
 	{
-		msgBox.set("Couldn't load list of saves", MessageBox::Type::Warning);
-		state = State::Message;
+		Vector<size_t>& index = saveIndex[order];
+		index.clear();
+		for (size_t i = 0; i < saves.size(); ++i)
+			index.pushBack(i);
+		index.sort(GameSave_OrderCmp(saves, SaveOrder(order)));
 	}
+	scrollSaves(0);
+	++savesVersion;
+
+	if (result != EOF)
+		showMessage("Couldn't load list of saves", MessageBox::Type::Warning);
 }
 
 void Application::load(size_t idx)
@@ -213,121 +573,427 @@ void Application::load(size_t idx)
 
 		if (board.loadFrom(savePath))
 		{
-			msgBox.set("Loading completed");
-			state = State::Message;
+			showMessage("Loading completed");
 
 			points = saves[idx].points;
-			clock.setWorldTime(saves[idx].worldTime);
+			clock->setWorldTime(saves[idx].worldTime);
+			journal.checkpoint(board, points, saves[idx].worldTime);
 
 			return;
 		}
 	}
 
-	msgBox.set("Loading failed", MessageBox::Type::Warning);
-	state = State::Message;
-	return;
+	showMessage("Loading failed", MessageBox::Type::Warning);
+}
+
+void Application::scrollSaves(int32_t rows)
+{
+	int32_t last = maxVal(int32_t(saves.size()) - int32_t(visibleSaveRows()), 0);
+	firstVisibleSave = size_t(clamped(int32_t(firstVisibleSave) + rows, 0, last));
+}
+
+size_t Application::visibleSaveRows() const
+{
+	// the bottom row is taken by the input line
+	return size_t(int32_t(WinSize.y) - SaveListTop - 20) / SaveRowHeight;
 }
 
 void Application::logic()
 {
-	if (shiftDirection != Direction::Count)
+	// the policy moves once the last slide is over, like a player who waits for it
+	if (autoPlay && state == State::Playing && !moveQueueCount && !board.isSliding())
 	{
-		int32_t value = board.shiftTo(shiftDirection);
+		Direction direction = autoPlayer.chooseMove(board, autoPolicy);
+		stepResized |= autoPlayer.hasReshaped();
+		if (direction != Direction::Count)
+			queueMove(direction, InputTag());
+	}
+
+	// a move ends the running slide at once, so no key press waits for the animation
+	for (; moveQueueCount && state == State::Playing; --moveQueueCount)
+	{
+		QueuedMove const& move = moveQueue[moveQueueStart];
+		Direction direction = move.direction;
+		moveQueueStart = (moveQueueStart + 1) % MoveQueueSize;
+
+		if (board.finishAnimation())
+			endSlide();
+
+		int32_t value = board.shiftTo(direction);
 		if (value > 0)
 		{
 			prevPoints = points;
 			points += value;
 		}
-		shiftDirection = Direction::Count;
+		if (value >= 0)
+		{
+			if (shouldJournal())
+				journal.recordMove(direction, points, clock->getWorldTime());
+			++moveCount;
+
+			if (quitAfter && moveCount >= quitAfter)
+				state = State::Quitting;
+
+			// the moves of the autoplay have no key press to time
+			if (move.input.received)
+				shiftedInputs[shiftedInputCount++ % ShiftedInputCount] = move.input;
+		}
+	}
+	moveQueueCount = 0;
+
+	if (journal.needsCheckpoint() || (unjournaledMoves && (!isTurboRunning() || SDL_GetTicks() - turboCheckpointTime >= TurboCheckpointInterval)))
+		checkpoint();
+
+	if (board.update(SimulationStep))
+		endSlide();
+}
+
+void Application::playTurbo()
+{
+	// the render thread draws only the newest snapshot, so more than one per refresh would be wasted
+	for (uint32_t moves = 0; isTurboRunning(); )
+	{
+		logic();
+
+		if (turboEvery ? ++moves >= turboEvery : clock->hasFramePassed())
+			return;
 	}
+}
+
+bool Application::isTurboRunning() const
+{
+	return autoPlay && turbo && state == State::Playing;
+}
+
+bool Application::shouldJournal()
+{
+	if (isTurboRunning())
+		unjournaledMoves = true;
+	else if (unjournaledMoves)
+		checkpoint();
+	else
+		return true;
 
-	if (board.update(clock.getDeltaTime()))
+	return false;
+}
+
+void Application::checkpoint()
+{
+	journal.checkpoint(board, points, clock->getWorldTime());
+	unjournaledMoves = false;
+	turboCheckpointTime = SDL_GetTicks();
+}
+
+void Application::updateMoveRate()
+{
+	Uint64 now = SDL_GetPerformanceCounter();
+	Uint64 frequency = SDL_GetPerformanceFrequency();
+
+	if (!rateStart)
+		rateStart = now;
+	else if (now - rateStart >= frequency)
 	{
-		board.addNewTile();
-		for (uint8_t i = 0; i < uint8_t(Direction::Count); ++i)
-			if (board.canShiftTo(Direction(i)))
-				return;
+		movesPerSecond = uint32_t(Uint64(moveCount - rateMoveCount) * frequency / (now - rateStart));
+		rateMoveCount = moveCount;
+		rateStart = now;
+	}
+}
 
-		msgBox.set("Game Over");
-		state = State::Message;
+void Application::queueMove(Direction direction, InputTag const& input)
+{
+	if (moveQueueCount < MoveQueueSize)
+	{
+		QueuedMove& move = moveQueue[(moveQueueStart + moveQueueCount++) % MoveQueueSize];
+		move.direction = direction;
+		move.input = input;
 	}
 }
 
-void Application::display()
+void Application::endSlide()
+{
+	if (board.addNewTile() && shouldJournal())
+		journal.recordSpawn(board.getLastSpawn(), points, clock->getWorldTime());
+	for (uint8_t i = 0; i < uint8_t(Direction::Count); ++i)
+		if (board.canShiftTo(Direction(i)))
+			return;
+
+	if (quitAfter)
+		state = State::Quitting;
+	else
+		showMessage("Game Over");
+}
+
+bool Application::isIdle() const
 {
-	win.clear();
-	if(state != State::Loading && state != State::BoardSizeChoice)
-		win.draw(board);
-	displayHUD();
+	return !autoPlay && !moveQueueCount && !board.isAnimating();
+}
+
+void Application::display(Snapshot const& frame)
+{
+	bool messageChanged = frame.state != drawnState || frame.messageType != drawnMessage || frame.message != drawnMessageText;
+
+	// a backend that loses the frame gets a complete one every time
+	if (messageChanged || frame.redrawCount != drawnRedrawCount || !win.keepsFrame())
+		fullRedraw = true;
+
+	bool full = fullRedraw;
+	fullRedraw = false;
+	drawnState = frame.state;
+	drawnMessage = frame.messageType;
+	drawnMessageText = frame.message;
+	drawnRedrawCount = frame.redrawCount;
+
+	viewReshaped = boardView.copyStateFrom(frame.board);
+
+	// drawn between the last two steps by the time since the last one, which went on after the snapshot was published
+	float_t sincePublish = float_t(SDL_GetPerformanceCounter() - frame.publishTime) * 1000.f / float_t(SDL_GetPerformanceFrequency());
+	boardView.setInterpolation((float_t(frame.simulationLag) + sincePublish) / float_t(SimulationStep));
+
+	displayScene(frame, full);
+
+	if (frame.messageType != MessageBox::Type::Count)
+	{
+		// the box is translucent, blended over itself it would darken, so a partial repaint becomes a full one
+		if (!full && win.isDirty())
+		{
+			full = true;
+			displayScene(frame, full);
+		}
+
+		if (full)
+		{
+			if (messageChanged || messageLayer.isEmpty())
+			{
+				msgBox.set(frame.message, frame.messageType);
+				messageLayer.clear();
+				messageLayer.setOpacity(MessageOpacity);
+				messageLayer.record(msgBox);
+			}
+			win.draw(messageLayer);
+		}
+	}
+
 	win.display();
+	measureLatency(frame);
 }
 
-void Application::displayHUD()
+void Application::displayScene(Snapshot const& frame, bool full)
 {
-	if (state == State::Loading)
-		displayLoadingPanel();
-	else if (state == State::BoardSizeChoice)
-		displaySizeChoicePanel();
+	if (full)
+	{
+		win.clear();
+		win.invalidate();
+		boardView.invalidate();
+	}
+
+	if (frame.state == State::Loading)
+	{
+		if (full)
+			displayLoadingPanel(frame);
+	}
+	else if (frame.state == State::BoardSizeChoice)
+	{
+		if (full)
+			displaySizeChoicePanel(frame);
+	}
 	else
 	{
-		char tStr[32];
+		// a zoomed or panned board would draw over the HUD, which isn't repainted with it
+		win.setClip({ 0, HUDHeight }, Vec2i(WinSize) - Vec2i(0, HUDHeight));
+		win.draw(boardView);
+		win.resetClip();
+		displayHUD(frame, full);
+	}
+}
+
+void Application::displayHUD(Snapshot const& frame, bool full)
+{
+	size_t seconds = frame.worldTime / 1000;
+	bool latencyChanged = frame.showLatency && eventLatency.getCount() != drawnLatencyCount;
+	bool rateChanged = frame.autoPlay && frame.movesPerSecond != drawnMovesPerSecond;
+
+	if (!full && seconds == drawnSeconds && frame.points == drawnPoints && !latencyChanged && !rateChanged)
+		return;
+
+	drawnSeconds = seconds;
+	drawnPoints = frame.points;
+	drawnLatencyCount = eventLatency.getCount();
+	drawnMovesPerSecond = frame.movesPerSecond;
+
+	static char const* const TimeLabel = "Game time: ";
+	static char const* const PointsLabel = "Points: ";
+	static int32_t const PointsX = 200;
+	static int32_t const AutoPlayX = 380;
+	static int32_t const LatencyX = 600;
+
+	char tStr[32];
 
-		sprintf_s(tStr, "Game time: %u sec", clock.getWorldTime() / 1000);
-		win.draw(Text(tStr));
+	win.clear(Color::Black, { 0, 0 }, Vec2i(int32_t(WinSize.x), HUDHeight));
+	win.invalidate({ 0, 0 }, Vec2i(int32_t(WinSize.x), HUDHeight));
+
+	if (hudLayer.isEmpty())
+	{
+		Text label(TimeLabel);
+		hudLayer.record(label);
+		label.set(PointsLabel);
+		label.setPosition({ PointsX, 0 });
+		hudLayer.record(label);
+	}
+	win.draw(hudLayer);
+
+	sprintf_s(tStr, "%u sec", seconds);
+	Text value(tStr);
+	value.setPosition({ int32_t(strlen(TimeLabel)) * CharsetGlyphSize, 0 });
+	win.draw(value);
+
+	sprintf_s(tStr, "%u", frame.points);
+	value.set(tStr);
+	value.setPosition({ PointsX + int32_t(strlen(PointsLabel)) * CharsetGlyphSize, 0 });
+	win.draw(value);
+
+	if (frame.autoPlay)
+	{
+		sprintf_s(tStr, "%s%s %u moves/s", AutoPlayer::getPolicyName(frame.autoPolicy), frame.turbo ? " turbo" : "", frame.movesPerSecond);
+		value.set(tStr);
+		value.setPosition({ AutoPlayX, 0 });
+		win.draw(value);
+	}
 
-		sprintf_s(tStr, "Points: %u", points);
-		Text pointsText(tStr);
-		pointsText.setPosition({ 200, 0 });
-		win.draw(pointsText);
+	if (frame.showLatency)
+	{
+		sprintf_s(tStr, "Lag: %u/%u ms", eventLatency.getPercentile(0.5f), eventLatency.getPercentile(0.99f));
+		value.set(tStr);
+		value.setPosition({ LatencyX, 0 });
+		win.draw(value);
 	}
+}
+
+void Application::measureLatency(Snapshot const& frame)
+{
+	if (measuredInputCount == frame.shiftedInputCount)
+		return;
+
+	Uint32 ticks = SDL_GetTicks();
+	Uint64 now = SDL_GetPerformanceCounter();
+	float_t frequency = float_t(SDL_GetPerformanceFrequency());
 
-	win.draw(msgBox);
+	// shifts the snapshot no longer holds went by between two frames
+	uint32_t oldest = frame.shiftedInputCount > ShiftedInputCount ? frame.shiftedInputCount - ShiftedInputCount : 0;
+
+	for (uint32_t i = maxVal(measuredInputCount, oldest); i != frame.shiftedInputCount; ++i)
+	{
+		InputTag const& input = frame.shiftedInputs[i % ShiftedInputCount];
+		eventLatency.record(float_t(ticks - input.timestamp));
+		receiveLatency.record(float_t(now - input.received) * 1000.f / frequency);
+	}
+	measuredInputCount = frame.shiftedInputCount;
 }
 
-void Application::displayLoadingPanel()
+void Application::displayLoadingPanel(Snapshot const& frame)
 {
+	static char const* const ColumnNames[] = { "Nr", "Save time", "Points", "Time", "Preview" };
+	static int32_t const ColumnX[] = { 0, 50, 150, 250, 350 };
+	static int8_t const SortedColumn[uint8_t(SaveOrder::Count)] = { 1, 2, 3 };
+	static char const* const SortHint = "  T/P/W - sort";
+	static char const* const InputLabel = "Save to load: ";
+
 	Text txt;
 	char buffer[64];
 
-	txt.set("Nr");
-	win.draw(txt);
+	if (loadingLayerOrder != frame.saveOrder)
+	{
+		loadingLayer.clear();
+		loadingLayerOrder = frame.saveOrder;
 
-	txt.set("Save time");
-	txt.setPosition({ 50, 0 });
-	win.draw(txt);
+		for (uint8_t i = 0; i < sizeof(ColumnX) / sizeof(*ColumnX); ++i)
+		{
+			if (SortedColumn[uint8_t(frame.saveOrder)] == i)
+			{
+				sprintf_s(buffer, "%s*", ColumnNames[i]);
+				txt.set(buffer);
+			}
+			else
+				txt.set(ColumnNames[i]);
+			txt.setPosition({ ColumnX[i], 0 });
+			loadingLayer.record(txt);
+		}
+
+		txt.setPosition({ int32_t(WinSize.x), int32_t(WinSize.y) });
+		txt.setOrigin({ 1.f, 1.f });
+		txt.set(SortHint);
+		loadingLayer.record(txt);
 
-	txt.move({ 0,30 });
+		txt.setPosition({ 0, int32_t(WinSize.y) });
+		txt.setOrigin({ 0.f, 1.f });
+		txt.set(InputLabel);
+		loadingLayer.record(txt);
 
-	for (size_t i = 0; i < saves.size(); ++i)
+		txt.setOrigin({ 0.f, 0.f });
+	}
+	win.draw(loadingLayer);
+
+	// only the visible rows are laid out, so the cost does not depend on the number of saves
+	Vector<size_t> const& index = frame.saveIndex[uint8_t(frame.saveOrder)];
+	size_t end = minVal(frame.firstVisibleSave + visibleSaveRows(), index.size());
+	Sprite thumbnail;
+
+	for (size_t row = frame.firstVisibleSave; row < end; ++row)
 	{
-		txt.move({ -50, 0 });
+		size_t i = index[row];
+		int32_t y = SaveListTop + int32_t(row - frame.firstVisibleSave) * SaveRowHeight;
+
 		sprintf_s(buffer, "%u", i + 1);
 		txt.set(buffer);
+		txt.setPosition({ ColumnX[0], y });
 		win.draw(txt);
 
-		sprintf_s(buffer, "%u", saves[i].saveTime);
-		txt.move({ 50, 0 });
+		sprintf_s(buffer, "%u", frame.saves[i].saveTime);
 		txt.set(buffer);
+		txt.setPosition({ ColumnX[1], y });
 		win.draw(txt);
 
-		txt.move({ 0,11 });
+		sprintf_s(buffer, "%u", frame.saves[i].points);
+		txt.set(buffer);
+		txt.setPosition({ ColumnX[2], y });
+		win.draw(txt);
+
+		sprintf_s(buffer, "%u s", frame.saves[i].worldTime / 1000);
+		txt.set(buffer);
+		txt.setPosition({ ColumnX[3], y });
+		win.draw(txt);
+
+		thumbnail.surface = thumbnails.get(frame.saves[i].saveTime);
+		if (thumbnail.surface)
+		{
+			thumbnail.setPosition({ ColumnX[4], y });
+			win.draw(thumbnail);
+		}
 	}
 
-	txt.setPosition({ 0, int32_t(WinSize.y) });
-	txt.setOrigin({ 0.f, 1.f });
-	sprintf_s(buffer, "Save to load: %s", inputStr);
+	txt.setPosition({ int32_t(WinSize.x) - int32_t(strlen(SortHint)) * CharsetGlyphSize, int32_t(WinSize.y) });
+	txt.setOrigin({ 1.f, 1.f });
+	sprintf_s(buffer, "%u-%u of %u", minVal(frame.firstVisibleSave + 1, index.size()), end, index.size());
 	txt.set(buffer);
 	win.draw(txt);
+
+	txt.setPosition({ int32_t(strlen(InputLabel)) * CharsetGlyphSize, int32_t(WinSize.y) });
+	txt.setOrigin({ 0.f, 1.f });
+	txt.set(frame.inputStr);
+	win.draw(txt);
+
+	// repaint until every visible thumbnail has arrived
+	if (thumbnails.hasPending())
+		fullRedraw = true;
 }
 
-void Application::displaySizeChoicePanel()
+void Application::displaySizeChoicePanel(Snapshot const& frame)
 {
 	Text txt;
 	char buffer[64];
 
 	txt.setPosition(Vec2i(WinSize) / 2);
 	txt.setOrigin({ 0.5f, 0.5f });
-	sprintf_s(buffer, "Board size: %s", inputStr);
+	sprintf_s(buffer, "Board size: %s", frame.inputStr);
 	txt.set(buffer);
 	win.draw(txt);
 }
\ No newline at end of file
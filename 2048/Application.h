@@ -3,10 +3,53 @@
 #include "Window.h"
 #include "Clock.h"
 #include "Board.h"
+#include "Journal.h"
+#include "ThumbnailCache.h"
+#include "DisplayList.h"
+#include "TripleBuffer.h"
+#include "EventQueue.h"
+#include "LatencyHistogram.h"
+#include "AutoPlayer.h"
 
 
 static const Vec2u WinSize(720, 560);
 
+static const int32_t HUDHeight = 8;
+
+// per notch of the mouse wheel
+static const float_t BoardZoomStep = 1.25f;
+
+// the game advances in steps of this many milliseconds, whatever the frame rate
+static const size_t SimulationStep = 5;
+
+// past it a slow frame slows the game down instead of making the next frame even slower
+static const size_t MaxSimulationLag = 20 * SimulationStep;
+
+static const size_t FastForwardFactor = 4;
+
+// key presses waiting for the next step, more are ignored
+static const size_t MoveQueueSize = 16;
+
+// the last shifts a snapshot tells the time of, older ones between two frames aren't measured
+static const uint32_t ShiftedInputCount = 64;
+
+static const int32_t SaveListTop = 30;
+
+static const int32_t SaveRowHeight = int32_t(ThumbnailSize) + 2;
+
+// the board shows a little through the message box
+static const uint8_t MessageOpacity = 0xe0;
+
+// in milliseconds, a turbo game is too fast for the journal, so it is checkpointed this often instead
+static const uint32_t TurboCheckpointInterval = 1000;
+
+// the render thread waits at most this long for a new snapshot or a change of the window
+static const uint32_t RenderIdleTimeout = 1000;
+
+// the main thread sleeps in SDL_WaitEventTimeout, which polls every 10 ms in SDL 2.0.7,
+// the render thread wakes it with an event when it is done
+static const uint32_t EventWaitTimeout = 100;
+
 
 struct GameSave
 {
@@ -21,19 +64,161 @@ struct GameSave_SaveTimeCmp
 { bool operator()(GameSave const& left, GameSave const& right) const { return left.saveTime == right.saveTime; } };
 
 
+// a key press on its way to the screen
+struct InputTag
+{
+	// SDL's time of the event, on SDL_GetTicks
+	Uint32 timestamp = 0;
+
+	// when the main thread took it from SDL, on the performance counter
+	Uint64 received = 0;
+};
+
+
+enum class SaveOrder : uint8_t { SaveTime, Points, WorldTime, Count };
+
+// orders indices of saves, the best score and the longest game go first
+struct GameSave_OrderCmp
+{
+	GameSave_OrderCmp(Vector<GameSave> const& saves, SaveOrder order) : saves(saves), order(order) {}
+
+	bool operator()(size_t left, size_t right) const
+	{
+		if (order == SaveOrder::Points)
+			return saves[left].points > saves[right].points;
+		if (order == SaveOrder::WorldTime)
+			return saves[left].worldTime > saves[right].worldTime;
+		return saves[left].saveTime < saves[right].saveTime;
+	}
+
+	Vector<GameSave> const& saves;
+
+	SaveOrder order;
+};
+
+
 
 class Application
 {
 	enum class State : uint8_t { Playing, Loading, Quitting, Message, BoardSizeChoice, Count };
 
+	struct QueuedMove
+	{
+		Direction direction = Direction::Count;
+
+		InputTag input;
+	};
+
+	// everything the render thread draws, the simulation thread fills one after every step
+	struct Snapshot
+	{
+		State state = State::BoardSizeChoice;
+
+		Board board;
+
+		// a string literal, so it outlives the snapshot
+		char const* message = nullptr;
+
+		MessageBox::Type messageType = MessageBox::Type::Count;
+
+		size_t points = 0;
+
+		size_t worldTime = 0;
+
+		bool animating = false;
+
+		// the steps are interpolated by the time since the snapshot was published
+		size_t simulationLag = 0;
+
+		Uint64 publishTime = 0;
+
+		// bumped by anything the panels or the camera show, the next frame is then repainted whole
+		uint32_t redrawCount = 0;
+
+
+		// the key presses of the last shifts, by the number of the shift
+		InputTag shiftedInputs[ShiftedInputCount];
+
+		uint32_t shiftedInputCount = 0;
+
+		bool showLatency = false;
+
+
+		bool autoPlay = false;
+
+		bool turbo = false;
+
+		AutoPolicy autoPolicy = AutoPolicy::Greedy;
+
+		uint32_t movesPerSecond = 0;
+
+
+		// copied only after the list was loaded again
+		uint32_t savesVersion = 0;
+
+		Vector<GameSave> saves;
+
+		Vector<size_t> saveIndex[uint8_t(SaveOrder::Count)];
+
+		SaveOrder saveOrder = SaveOrder::SaveTime;
+
+		size_t firstVisibleSave = 0;
+
+		char inputStr[32] = { 0 };
+	};
+
 public:
 
-	Application();
+	// -renderer selects the SDL_Renderer backend, -locked draws into the locked screen texture,
+	// -driver <name> selects the SDL render driver, -turbo-every <n> shows every nth move of a turbo game,
+	// -virtual-clock <ms> steps the game by that much time without ever sleeping and keeps no journal,
+	// -virtual-clock-script <ms>,<ms>,... steps it by those times in turn, -board-size <n> starts on an n by n board,
+	// -quit-after <n> quits after n moves or at the game over, -autoplay starts the autoplay
+	Application(int argc, char** argv);
 
+	Application(Application const&) = delete;
+
+	Application& operator=(Application const&) = delete;
+
+	~Application();
+
+
+	// takes the window's events on the calling thread while the game and the rendering run on their own ones,
+	// returns after both are done
 	int run();
 
+	// for comparing runs on the virtual clock once run has returned
+	size_t getWorldTime() const { return clock->getWorldTime(); }
+
+	uint32_t getMoveCount() const { return moveCount; }
+
 private:
 
+	static WindowProperties parseArguments(int argc, char** argv);
+
+	// a comma separated list of milliseconds
+	static void parseScript(char const* list, Vector<Clock::TimePoint_t>& steps);
+
+
+	// the main thread does nothing else, so a slow frame never delays the input
+	void forwardEvents();
+
+	static int simulationMain(void* app);
+
+	void simulate();
+
+	// the state of the game goes to the render thread, which is woken up if it sleeps
+	void publish();
+
+	static int renderMain(void* app);
+
+	// owns the renderer, draws every snapshot and returns once the game quits
+	void render();
+
+	// at most one wake is pending at a time
+	void wakeRenderer();
+
+
 	void input();
 
 	void playingInput(SDL_Event const& event);
@@ -45,8 +230,12 @@ private:
 	void messageInput(SDL_Event const& event);
 
 
+	void showMessage(char const* text, MessageBox::Type type = MessageBox::Type::Info);
+
 	void reset();
 
+	void resume(bool fromJournal);
+
 
 	void save();
 
@@ -54,29 +243,92 @@ private:
 
 	void load(size_t idx);
 
+	void scrollSaves(int32_t rows);
+
+	size_t visibleSaveRows() const;
+
 
 	void logic();
 
+	// moves without waiting until a frame's worth of time has passed or turboEvery moves were made
+	void playTurbo();
+
+	bool isTurboRunning() const;
+
+	// false while a turbo game runs, and for the change that stops it, which is covered by the checkpoint taken then
+	bool shouldJournal();
+
+	void checkpoint();
 
+	void updateMoveRate();
 
-	void display();
+	// the key press is timed until the screen shows the shift it made
+	void queueMove(Direction direction, InputTag const& input);
 
-	void displayHUD();
+	// a spawn after every slide, the game is over if nothing can move then
+	void endSlide();
 
-	void displayLoadingPanel();
+	// nothing would change on the screen until an event comes or the clock of the HUD ticks
+	bool isIdle() const;
 
-	void displaySizeChoicePanel();
+
+
+	void display(Snapshot const& frame);
+
+	// everything but the message box
+	void displayScene(Snapshot const& frame, bool full);
+
+	void displayHUD(Snapshot const& frame, bool full);
+
+	void displayLoadingPanel(Snapshot const& frame);
+
+	void displaySizeChoicePanel(Snapshot const& frame);
+
+	// records the key presses of the shifts the screen has just shown for the first time
+	void measureLatency(Snapshot const& frame);
 
 private:
 	
 	Window win;
 
-	SimulationClock clock;
+	TripleBuffer<Snapshot> frames;
+
+	EventQueue events;
+
+	// posted whenever events were forwarded
+	SDL_sem* simulationWake = nullptr;
+
+	// posted by a new snapshot or a change of the window
+	SDL_sem* renderWake = nullptr;
+
+	SDL_atomic_t wakePending = { 0 };
+
+	// set by the main thread, the render thread repaints everything then
+	SDL_atomic_t windowChanged = { 0 };
+
+	// set by the window's close button, even if the event queue is full
+	SDL_atomic_t quitRequested = { 0 };
+
+	// the main thread stops taking events once the render thread is done
+	SDL_atomic_t renderDone = { 0 };
+
+
+	// owned by the simulation thread from here
+
+	// a VirtualClock for -virtual-clock, otherwise a SimulationClock
+	Clock* clock = nullptr;
 
 	Board board;
 
+	Journal journal;
+
+
+	// oldest first
+	QueuedMove moveQueue[MoveQueueSize];
+
+	size_t moveQueueStart = 0;
 
-	Direction shiftDirection = Direction::Count;
+	size_t moveQueueCount = 0;
 
 	size_t points = 0;
 
@@ -85,12 +337,133 @@ private:
 
 	State state = State::BoardSizeChoice;
 
-	MessageBox msgBox;
+	// where the game goes if resuming from the journal is declined
+	State resumeFallback = State::BoardSizeChoice;
+
+	char const* message = nullptr;
+
+	MessageBox::Type messageType = MessageBox::Type::Count;
 
 	Vector<GameSave> saves;
 
+	uint32_t savesVersion = 0;
+
+	// prebuilt orderings of saves, one per SaveOrder
+	Vector<size_t> saveIndex[uint8_t(SaveOrder::Count)];
+
+	SaveOrder saveOrder = SaveOrder::SaveTime;
+
+	size_t firstVisibleSave = 0;
+
 
 	char inputStr[32] = { 0 };
 
 	size_t inputLen = 0;
+
+	uint32_t redrawCount = 0;
+
+	// when the event being handled was taken from SDL
+	Uint64 eventReceived = 0;
+
+	InputTag shiftedInputs[ShiftedInputCount];
+
+	uint32_t shiftedInputCount = 0;
+
+	bool showLatency = false;
+
+
+	AutoPlayer autoPlayer;
+
+	AutoPolicy autoPolicy = AutoPolicy::Greedy;
+
+	bool autoPlay = false;
+
+	// slides end at once and the autoplay doesn't wait for the steps
+	bool turbo = false;
+
+	// 0 publishes one state per refresh of the display
+	uint32_t turboEvery = 0;
+
+	// 0 plays on until the player quits
+	uint32_t quitAfter = 0;
+
+	// drawn on the main thread, the C runtime keeps the state of rand per thread
+	unsigned simulationSeed = 0;
+
+	// the board has changed since the last checkpoint without being journaled
+	bool unjournaledMoves = false;
+
+	Uint32 turboCheckpointTime = 0;
+
+	// every shift, for the rate of moves
+	uint32_t moveCount = 0;
+
+	uint32_t rateMoveCount = 0;
+
+	Uint64 rateStart = 0;
+
+	uint32_t movesPerSecond = 0;
+
+	// the snapshot or the autoplay copied into something of another size, so the step isn't checked for allocations
+	bool stepResized = false;
+
+
+	// real time not simulated yet
+	size_t simulationLag = 0;
+
+	bool fastForward = false;
+
+
+	// owned by the render thread from here
+
+	// always on the real clock, a virtual one would spin the render thread
+	SimulationClock frameClock;
+
+	// the board of the last snapshot drawn, it keeps what is on the screen
+	Board boardView;
+
+	// the frame copied a board of another shape, so it allocated
+	bool viewReshaped = false;
+
+	MessageBox msgBox;
+
+	ThumbnailCache thumbnails;
+
+
+	// what is on the screen, anything else gets repainted
+	bool fullRedraw = true;
+
+	uint32_t drawnRedrawCount = 0;
+
+	State drawnState = State::Count;
+
+	MessageBox::Type drawnMessage = MessageBox::Type::Count;
+
+	char const* drawnMessageText = nullptr;
+
+	size_t drawnSeconds = 0;
+
+	size_t drawnPoints = 0;
+
+
+	// text that doesn't change between repaints
+	Layer hudLayer;
+
+	Layer loadingLayer;
+
+	SaveOrder loadingLayerOrder = SaveOrder::Count;
+
+	Layer messageLayer;
+
+
+	// from the key press to the frame that shows its shift
+	LatencyHistogram eventLatency = LatencyHistogram("Key press to screen");
+
+	LatencyHistogram receiveLatency = LatencyHistogram("Received key press to screen");
+
+	uint32_t measuredInputCount = 0;
+
+	uint32_t drawnLatencyCount = 0;
+
+	uint32_t drawnMovesPerSecond = 0;
 };
\ No newline at end of file
@@ -0,0 +1,106 @@
+#include "AutoPlayer.h"
+
+
+char const * AutoPlayer::getPolicyName(AutoPolicy policy)
+{
+	static char const* const Names[uint8_t(AutoPolicy::Count)] = { "Random", "Greedy", "Search" };
+	return policy < AutoPolicy::Count ? Names[uint8_t(policy)] : "";
+}
+
+Direction AutoPlayer::chooseMove(Board const & board, AutoPolicy policy)
+{
+	reshaped = false;
+	if (policy == AutoPolicy::Random)
+		return chooseRandom(board);
+
+	Vec2u size = board.getSize();
+	bool search = policy == AutoPolicy::Search && size.x * size.y <= MaxSearchTiles;
+	reshaped = firstShift.getSize() != size || (search && (spawned.getSize() != size || secondShift.getSize() != size));
+	return chooseBest(board, search);
+}
+
+Direction AutoPlayer::chooseRandom(Board const & board)
+{
+	Direction possible[uint8_t(Direction::Count)];
+	uint8_t count = 0;
+
+	for (uint8_t i = 0; i < uint8_t(Direction::Count); ++i)
+		if (board.canShiftTo(Direction(i)))
+			possible[count++] = Direction(i);
+
+	return count ? possible[rand() % count] : Direction::Count;
+}
+
+Direction AutoPlayer::chooseBest(Board const & board, bool search)
+{
+	Direction best = Direction::Count;
+	float_t bestValue = 0.f;
+
+	for (uint8_t i = 0; i < uint8_t(Direction::Count); ++i)
+	{
+		float_t value = 0.f;
+
+		if (search)
+		{
+			int32_t points = shift(board, Direction(i), firstShift);
+			if (points < 0)
+				continue;
+			value = float_t(points) + spawnValue(firstShift);
+		}
+		else if ((value = greedyValue(board, Direction(i), firstShift)) < 0.f)
+			continue;
+
+		if (best == Direction::Count || value > bestValue)
+		{
+			best = Direction(i);
+			bestValue = value;
+		}
+	}
+
+	return best;
+}
+
+int32_t AutoPlayer::shift(Board const & board, Direction direction, Board & shifted)
+{
+	if (!board.canShiftTo(direction))
+		return -1;
+
+	shifted = board;
+	int32_t points = shifted.shiftTo(direction);
+	shifted.finishAnimation();
+	return points;
+}
+
+float_t AutoPlayer::greedyValue(Board const & board, Direction direction, Board & shifted)
+{
+	int32_t points = shift(board, direction, shifted);
+	if (points < 0)
+		return -1.f;
+
+	return float_t(points) + EmptyTileBonus * float_t(shifted.countEmptyTiles());
+}
+
+float_t AutoPlayer::spawnValue(Board const & shifted)
+{
+	Vec2u size = shifted.getSize();
+	float_t total = 0.f;
+	size_t spawns = 0;
+
+	for (size_t i = 0; i < size.y; ++i)
+		for (size_t j = 0; j < size.x; ++j)
+		{
+			spawned = shifted;
+			if (!spawned.addNewTileAt(Vec2u(j, i)))
+				continue;
+
+			// a spawn that ends the game is worth nothing
+			float_t best = 0.f;
+			for (uint8_t k = 0; k < uint8_t(Direction::Count); ++k)
+				best = maxVal(best, greedyValue(spawned, Direction(k), secondShift));
+
+			total += best;
+			++spawns;
+		}
+
+	return spawns ? total / float_t(spawns) : 0.f;
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include "Board.h"
+
+
+enum class AutoPolicy : uint8_t { Random, Greedy, Search, Count };
+
+
+// what an empty tile is worth next to the points of a shift
+static float_t const EmptyTileBonus = 16.f;
+
+// larger boards are played greedily, the search tries a spawn on every empty tile
+static size_t const MaxSearchTiles = 64;
+
+
+
+// picks the moves of a game that plays itself
+class AutoPlayer
+{
+public:
+
+	static char const* getPolicyName(AutoPolicy policy);
+
+
+	// Direction::Count if nothing can move, the board must not be sliding
+	Direction chooseMove(Board const& board, AutoPolicy policy);
+
+	// the last move was chosen on boards of another shape, which had to be allocated
+	bool hasReshaped() const { return reshaped; }
+
+private:
+
+	static Direction chooseRandom(Board const& board);
+
+	// the move worth the most, greedily or by what the best next move is worth after each spawn
+	Direction chooseBest(Board const& board, bool search);
+
+	// the points of the shift, negative if it can't be made
+	static int32_t shift(Board const& board, Direction direction, Board& shifted);
+
+	// the points and the empty tiles after the shift, negative if it can't be made
+	static float_t greedyValue(Board const& board, Direction direction, Board& shifted);
+
+	// the mean over the spawns of the best greedy move after them
+	float_t spawnValue(Board const& shifted);
+
+private:
+
+	// the boards after the first shift, a spawn and the second shift, kept so their tiles are allocated once
+	Board firstShift;
+
+	Board spawned;
+
+	Board secondShift;
+
+	bool reshaped = false;
+};
@@ -0,0 +1,202 @@
+#include "Blitter.h"
+
+#ifdef BLITTER_SSE2
+#include <emmintrin.h>
+#endif
+
+
+// what happens to every pixel of a row
+struct RowOp
+{
+	// applied to the copied pixels, sets the alpha of a source without one
+	Uint32 keep = 0xffffffff;
+	Uint32 fill = 0;
+
+	bool keyed = false;
+	Uint32 rgbMask = 0xffffffff;
+	Uint32 key = 0;
+
+	// by the alpha of the source, never together with a key
+	bool blend = false;
+};
+
+
+
+static Uint32 copyPixel(Uint32 s, RowOp const& op)
+{
+	return (s & op.keep) | op.fill;
+}
+
+// the colors like SDL's per pixel alpha blitter, d + (s - d) * a / 256, the alpha a + dA * (255 - a) / 256
+static Uint32 blendPixel(Uint32 s, Uint32 d, Uint32 a)
+{
+	Uint32 result = 0;
+	for (Uint32 shift = 0; shift < 24; shift += 8)
+		result |= ((((d >> shift) & 0xff) * (256 - a) + ((s >> shift) & 0xff) * a) >> 8) << shift;
+
+	return result | ((((a << 8) + (d >> 24) * (255 - a)) >> 8) << 24);
+}
+
+static void drawRow(Uint32* d, Uint32 const* s, int32_t n, RowOp const& op)
+{
+	for (; n > 0; --n, ++d, ++s)
+	{
+		if (!op.blend)
+		{
+			if (!op.keyed || (*s & op.rgbMask) != op.key)
+				*d = copyPixel(*s, op);
+			continue;
+		}
+
+		// fully transparent and opaque pixels aren't blended, like in SDL, an opaque one keeps the alpha of the destination
+		Uint32 a = *s >> 24;
+		if (a == 255)
+			*d = (*s & 0x00ffffff) | (*d & 0xff000000);
+		else if (a)
+			*d = blendPixel(*s, *d, a);
+	}
+}
+
+
+
+#ifdef BLITTER_SSE2
+
+static __m128i select(__m128i mask, __m128i a, __m128i b)
+{
+	return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+// two pixels, a channel per 16 bit lane, the alpha is repeated over the lanes of its pixel
+static __m128i blendHalf(__m128i src, __m128i dest, __m128i alpha)
+{
+	__m128i colorLanes = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+	__m128i destWeight = _mm_sub_epi16(_mm_set_epi16(255, 256, 256, 256, 255, 256, 256, 256), alpha);
+
+	// no lane goes past 255 * 256, so 16 bits are enough
+	__m128i sum = _mm_add_epi16(_mm_mullo_epi16(dest, destWeight), _mm_mullo_epi16(src, _mm_and_si128(alpha, colorLanes)));
+	sum = _mm_add_epi16(sum, _mm_slli_epi16(_mm_andnot_si128(colorLanes, alpha), 8));
+	return _mm_srli_epi16(sum, 8);
+}
+
+static void drawRowSse2(Uint32* d, Uint32 const* s, int32_t n, RowOp const& op)
+{
+	__m128i zero = _mm_setzero_si128();
+	__m128i opaque = _mm_set1_epi32(255);
+	__m128i keep = _mm_set1_epi32(int(op.keep));
+	__m128i fill = _mm_set1_epi32(int(op.fill));
+	__m128i rgbMask = _mm_set1_epi32(int(op.rgbMask));
+	__m128i key = _mm_set1_epi32(int(op.key));
+	__m128i destAlpha = _mm_set1_epi32(int(0xff000000));
+
+	for (; n >= 4; n -= 4, d += 4, s += 4)
+	{
+		__m128i src = _mm_loadu_si128((__m128i const*)s);
+		__m128i dest = _mm_loadu_si128((__m128i const*)d);
+
+		if (!op.blend)
+		{
+			__m128i copied = _mm_or_si128(_mm_and_si128(src, keep), fill);
+			__m128i keyed = op.keyed ? _mm_cmpeq_epi32(_mm_and_si128(src, rgbMask), key) : zero;
+			_mm_storeu_si128((__m128i*)d, select(keyed, dest, copied));
+			continue;
+		}
+
+		// the upper halves of the 32 bit lanes stay zero
+		__m128i alpha = _mm_srli_epi32(src, 24);
+
+		__m128i words = _mm_or_si128(alpha, _mm_slli_epi32(alpha, 16));
+		__m128i blended = _mm_packus_epi16(
+			blendHalf(_mm_unpacklo_epi8(src, zero), _mm_unpacklo_epi8(dest, zero), _mm_unpacklo_epi32(words, words)),
+			blendHalf(_mm_unpackhi_epi8(src, zero), _mm_unpackhi_epi8(dest, zero), _mm_unpackhi_epi32(words, words)));
+
+		blended = select(_mm_cmpeq_epi32(alpha, opaque), select(destAlpha, dest, src), blended);
+		blended = select(_mm_cmpeq_epi32(alpha, zero), dest, blended);
+		_mm_storeu_si128((__m128i*)d, blended);
+	}
+
+	drawRow(d, s, n, op);
+}
+
+#endif
+
+
+
+bool Blitter::blit(SDL_Surface * src, SDL_Rect const & srcRect, SDL_Surface * dst, SDL_Rect const & destRect)
+{
+	SDL_PixelFormat const* srcFormat = src->format;
+	SDL_PixelFormat const* dstFormat = dst->format;
+
+	// the alpha, if any, has to be the top byte, the destination always has one
+	if (srcFormat->BytesPerPixel != 4 || dstFormat->BytesPerPixel != 4
+		|| srcFormat->Rmask != dstFormat->Rmask || srcFormat->Gmask != dstFormat->Gmask || srcFormat->Bmask != dstFormat->Bmask
+		|| (srcFormat->Amask && srcFormat->Amask != 0xff000000) || dstFormat->Amask != 0xff000000
+		|| SDL_MUSTLOCK(src) || SDL_MUSTLOCK(dst))
+		return false;
+
+	if (srcRect.w <= 0 || srcRect.h <= 0 || destRect.w <= 0 || destRect.h <= 0 || destRect.w % srcRect.w || destRect.h % srcRect.h
+		|| srcRect.x < 0 || srcRect.y < 0 || srcRect.x + srcRect.w > src->w || srcRect.y + srcRect.h > src->h)
+		return false;
+
+	Uint8 r = 0, g = 0, b = 0, alphaMod = 0;
+	SDL_BlendMode mode = SDL_BLENDMODE_NONE;
+	SDL_GetSurfaceColorMod(src, &r, &g, &b);
+	SDL_GetSurfaceAlphaMod(src, &alphaMod);
+	SDL_GetSurfaceBlendMode(src, &mode);
+
+	RowOp op;
+	op.keep = srcFormat->Amask ? 0xffffffff : ~dstFormat->Amask;
+	op.fill = srcFormat->Amask ? 0 : dstFormat->Amask;
+	op.keyed = SDL_GetColorKey(src, &op.key) == 0;
+	op.rgbMask = ~srcFormat->Amask;
+	op.key &= op.rgbMask;
+	op.blend = mode == SDL_BLENDMODE_BLEND;
+
+	// SDL's generated and generic blitters, which do these and scaled blending, divide by 255 instead of shifting
+	if (r != 255 || g != 255 || b != 255 || alphaMod != 255 || (mode != SDL_BLENDMODE_NONE && mode != SDL_BLENDMODE_BLEND)
+		|| (op.blend && (!srcFormat->Amask || op.keyed || destRect.w != srcRect.w || destRect.h != srcRect.h)))
+		return false;
+
+	SDL_Rect clipped;
+	if (!SDL_IntersectRect(&destRect, &dst->clip_rect, &clipped))
+		return true;
+
+	int32_t scaleX = destRect.w / srcRect.w, scaleY = destRect.h / srcRect.h;
+
+	// SDL_BlitScaled rescales a clipped source rect in floating point and rounds it, which integer steps don't follow
+	if ((scaleX > 1 || scaleY > 1) && (clipped.w != destRect.w || clipped.h != destRect.h))
+		return false;
+	int32_t offsetX = clipped.x - destRect.x;
+
+	if (scaleX > 1)
+		scaledRow.resize(size_t(clipped.w));
+	int32_t scaledY = -1;
+
+	for (int32_t y = clipped.y; y < clipped.y + clipped.h; ++y)
+	{
+		int32_t srcY = srcRect.y + (y - destRect.y) / scaleY;
+		Uint32 const* s = (Uint32 const*)((Uint8 const*)src->pixels + srcY * src->pitch) + srcRect.x;
+		Uint32* d = (Uint32*)((Uint8*)dst->pixels + y * dst->pitch) + clipped.x;
+
+		// a scaled source row is spread out once for all the rows it covers
+		if (scaleX > 1)
+		{
+			if (srcY != scaledY)
+			{
+				for (int32_t i = 0; i < clipped.w; ++i)
+					scaledRow[i] = s[(offsetX + i) / scaleX];
+				scaledY = srcY;
+			}
+			s = scaledRow.getData();
+		}
+		else
+			s += offsetX;
+
+#ifdef BLITTER_SSE2
+		drawRowSse2(d, s, clipped.w, op);
+#else
+		drawRow(d, s, clipped.w, op);
+#endif
+	}
+
+	return true;
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include "SDL-2.0.7/include/SDL.h"
+#include "Utility.h"
+
+
+// 4 pixels per step, otherwise every pixel goes through the scalar code
+#if defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BLITTER_SSE2
+#endif
+
+
+
+// blits between 32 bit surfaces with the same color layout, with a color key or per pixel alpha blending and integer scaling,
+// giving the pixels of SDL_BlitSurface and SDL_BlitScaled, anything with a color or alpha mod and scaled blits cut by the clip rect
+// are left to SDL
+class Blitter
+{
+public:
+
+	// nothing is drawn if it returns false, then the caller falls back to SDL
+	bool blit(SDL_Surface* src, SDL_Rect const& srcRect, SDL_Surface* dst, SDL_Rect const& destRect);
+
+private:
+
+	// source pixels of a scaled row, one per destination pixel
+	Vector<Uint32> scaledRow;
+};
@@ -5,12 +5,14 @@
 
 static Vec2i const Directions[uint8_t(Direction::Count)] = { {-1,0},{1,0},{0,-1},{0,1} };
 
+static SDL_atomic_t lastVersion = { 0 };
+
 
 Board::Tile::Tile(bool isWall)
 {
-	outlineColor = TileColor;
-	setAsWall(isWall);
+	outlineColor = Palette::get(PaletteOutline);
 	value = TileBaseValue;
+	setAsWall(isWall);
 }
 
 void Board::Tile::draw(RenderTarget & target, Transform addTransform) const
@@ -20,7 +22,8 @@ void Board::Tile::draw(RenderTarget & target, Transform addTransform) const
 
 	if (value && !isWall)
 	{
-		Text valueTxt(nullptr, Color::Grey);
+		// light tiles get dark digits
+		Text valueTxt(nullptr, Palette::get(value <= 4 ? PaletteTileText : PaletteText));
 		valueTxt.scale({ 1.5f,2 });
 		valueTxt.setPosition(Vec2i(size.x, size.y) / 2);
 		valueTxt.setOrigin({ 0.5f, 0.5f });
@@ -37,9 +40,13 @@ void Board::Tile::draw(RenderTarget & target, Transform addTransform) const
 void Board::Tile::setAsWall(bool isWall)
 {
 	this->isWall = isWall;
-	if (isWall)
-		fillColor = WallTileColor;
-	else fillColor = TileColor;
+	updateColor();
+}
+
+void Board::Tile::setValue(size_t newValue)
+{
+	value = newValue;
+	updateColor();
 }
 
 int32_t Board::Tile::mergeWith(Tile & other)
@@ -47,6 +54,8 @@ int32_t Board::Tile::mergeWith(Tile & other)
 	merged = value && other.value;
 	value += other.value;
 	other.value = 0;
+	updateColor();
+	other.updateColor();
 	return int32_t(merged * value);
 }
 
@@ -55,6 +64,11 @@ void Board::Tile::confirmMerge()
 	merged = false;
 }
 
+void Board::Tile::updateColor()
+{
+	fillColor = Palette::tileColor(isWall ? -1 : int32_t(value));
+}
+
 bool Board::Tile::canMergeWith(Tile const& other) const
 {
 	return (!isWall && !other.isWall && !merged && !other.merged && (!value || !other.value || other.value == value));
@@ -64,6 +78,76 @@ bool Board::Tile::canMergeWith(Tile const& other) const
 
 
 
+Board::TileCache::~TileCache()
+{
+	clear();
+}
+
+SDL_Surface * Board::TileCache::get(Tile const & tile, int32_t size, RenderTarget & target)
+{
+	int32_t slot = slotOf(tile);
+	if (slot < 0 || size <= 0)
+		return nullptr;
+
+	if (size != tileSize)
+	{
+		clear();
+		tileSize = size;
+	}
+
+	if (!sprites[slot])
+	{
+		// the outline is drawn on both ends, so the sprite is one pixel larger than the tile
+		sprites[slot] = target.createSurface(Vec2u(tileSize + 1, tileSize + 1));
+		if (!sprites[slot])
+			return nullptr;
+
+		// tiles are opaque, so blitting them is a plain copy
+		SDL_SetSurfaceBlendMode(sprites[slot], SDL_BLENDMODE_NONE);
+
+		SurfaceTarget spriteTarget(sprites[slot], target);
+		Tile temp = tile;
+		temp.size = { tileSize, tileSize };
+		temp.setPosition({ 0, 0 });
+		temp.draw(spriteTarget);
+	}
+
+	return sprites[slot];
+}
+
+void Board::TileCache::clear()
+{
+	for (uint8_t i = 0; i < SlotCount; ++i)
+	{
+		RenderTarget::freeSurface(sprites[i]);
+		sprites[i] = nullptr;
+	}
+	tileSize = 0;
+}
+
+int32_t Board::TileCache::slotOf(Tile const & tile)
+{
+	if (tile.isAWall())
+		return 0;
+
+	size_t value = tile.getValue();
+	if (!value)
+		return 1;
+
+	// only powers of two get a slot, anything else loaded from a file is drawn directly
+	if (value & (value - 1))
+		return -1;
+
+	int32_t slot = 2;
+	for (; value > 1 && slot < SlotCount - 1; value >>= 1)
+		++slot;
+	return value == 1 ? slot : -1;
+}
+
+
+
+
+
 Board::Board()
 {
 	setDefaultShape(4);
@@ -73,104 +157,195 @@ void Board::draw(RenderTarget & target, Transform addTransform) const
 {
 	addTransform *= transform;
 
-	int32_t tileSize = size_t(float_t(WinSize.y / size.y) * 0.7f);
+	float_t tileExtent = float_t(WinSize.y) / float_t(size.y) * 0.7f * cameraZoom;
+	int32_t tileSize = int32_t(tileExtent);
 	int32_t tileBorderSize = int32_t(tileSize * 0.2);
+	int32_t pitch = tileSize + tileBorderSize;
 
-	addTransform.pos -= (tileSize * Vec2i(size.x, size.y) + tileBorderSize * Vec2i(size.x - 1, size.y - 1)) / 2;
+	Vec2i screenSize = target.getSize();
+
+	if (tileSize < LodTileSize)
+	{
+		float_t lodPitch = tileExtent * 1.2f;
+		Vec2f topLeft = Vec2f(addTransform.pos) - Vec2f(lodPitch * size.x * cameraCenter.x, lodPitch * size.y * cameraCenter.y);
+		drawLod(target, topLeft, lodPitch);
+		return;
+	}
+
+	Vec2i boardSize = tileSize * Vec2i(size.x, size.y) + tileBorderSize * Vec2i(size.x - 1, size.y - 1);
+	addTransform.pos -= Vec2i(int32_t(boardSize.x * cameraCenter.x), int32_t(boardSize.y * cameraCenter.y));
+
+	// only the tiles in the view are drawn
+	size_t firstCol = 0, lastCol = 0, firstRow = 0, lastRow = 0;
+	visibleRange(float_t(addTransform.pos.x), float_t(pitch), float_t(tileSize + 1), screenSize.x, size.x, firstCol, lastCol);
+	visibleRange(float_t(addTransform.pos.y), float_t(pitch), float_t(tileSize + 1), screenSize.y, size.y, firstRow, lastRow);
+
+	if (allDirty)
+	{
+		target.fillRect(addTransform.pos, boardSize + Vec2i(1, 1), Palette::get(PaletteBackground));
+		target.invalidate(addTransform.pos, boardSize + Vec2i(1, 1));
+	}
 
 	if (animate)
 	{
-		for (size_t i = 0; i < size.y; ++i)
-			for (size_t j = 0; j < size.x; ++j)
-			{
-				Transform temp = addTransform;
-				temp.pos += Vec2i(j, i) * tileSize + Vec2i(tileBorderSize * j, tileBorderSize * i);
+		// the board before the shift is the background, the moving tiles are then taken off their cells
+		if (allDirty)
+		{
+			for (size_t i = firstRow; i < lastRow; ++i)
+				for (size_t j = firstCol; j < lastCol; ++j)
+					queueTile(target, prevData[i][j], addTransform.pos + Vec2i(j, i) * pitch, tileSize);
+			drawQueuedTiles(target);
 
-				Vec2i moveVec = animationData[i][j];
-				if (moveVec.x || moveVec.y)
-				{
-					Tile tempTile;
-					tempTile.size = { tileSize, tileSize };
-					tempTile.setValue(0);
-					tempTile.draw(target, temp);
+			drawnAnimationTime = 0;
+			movesOnScreen = true;
+		}
 
-				}
-				else
-				{
-					Tile tempTile = prevData[i][j];
-					tempTile.size = { tileSize, tileSize };
-					tempTile.draw(target, temp);
+		// all the cells are repainted before any tile is drawn, so none covers a tile drawn this frame
+		for (size_t i = 0; i < moves.size(); ++i)
+			eraseMove(target, moves[i], addTransform.pos, pitch, tileSize, true);
 
-				}
+		size_t time = interpolated(previousAnimationTime, animationTime);
+		for (size_t i = 0; i < moves.size(); ++i)
+		{
+			Vec2i pos = movePosition(moves[i], addTransform.pos, pitch, time);
+			if (pos.x < screenSize.x && pos.y < screenSize.y && pos.x + tileSize >= 0 && pos.y + tileSize >= 0)
+			{
+				drawTile(target, moves[i].tile, pos, tileSize);
+				target.invalidate(pos, Vec2i(tileSize + 1, tileSize + 1));
 			}
-
-		for (size_t i = 0; i < size.y; ++i)
-			for (size_t j = 0; j < size.x; ++j)
-				if (animationData[i][j].x || animationData[i][j].y)
+		}
+		drawnAnimationTime = time;
+	}
+	else
+	{
+		// the last frame of the slide is cleaned up along with the changed tiles
+		if (movesOnScreen && !allDirty)
+			for (size_t i = 0; i < moves.size(); ++i)
+				eraseMove(target, moves[i], addTransform.pos, pitch, tileSize, false);
+		movesOnScreen = false;
+
+		for (size_t i = firstRow; i < lastRow; ++i)
+			for (size_t j = firstCol; j < lastCol; ++j)
+				if (allDirty || dirtyTiles[i][j])
 				{
-					Transform temp = addTransform;
-					temp.pos += Vec2i(j, i) * tileSize + Vec2i(tileBorderSize * j, tileBorderSize * i);
-
-					Tile tempTile = prevData[i][j];
-					tempTile.size = { tileSize, tileSize };
-					tempTile.setPosition(Vec2i(Vec2f(animationData[i][j]) * float_t(tileSize + tileBorderSize) * float_t(animationTime) / float_t(AnimationLength)));
+					Vec2i pos = addTransform.pos + Vec2i(j, i) * pitch;
+					queueTile(target, data[i][j], pos, tileSize);
 
-					tempTile.draw(target, temp);
+					if (!allDirty)
+						target.invalidate(pos, Vec2i(tileSize + 1, tileSize + 1));
+					dirtyTiles[i][j] = false;
 				}
+		drawQueuedTiles(target);
+
+		drawEffects(target, addTransform.pos, pitch, tileSize);
 	}
-	else
-		for (size_t i = 0; i < size.y; ++i)
-			for (size_t j = 0; j < size.x; ++j)
-			{
-				Transform temp = addTransform;
-				temp.pos += Vec2i(j, i) * tileSize + Vec2i(tileBorderSize * j, tileBorderSize * i);
 
-				Tile tempTile = data[i][j];
-				tempTile.size = { tileSize, tileSize };
-				tempTile.draw(target, temp);
-			}
+	allDirty = false;
+}
+
+void Board::pan(Vec2i const & offset)
+{
+	float_t pitch = getTilePitch();
+	cameraCenter.x = clamped(cameraCenter.x - offset.x / (pitch * size.x), 0.f, 1.f);
+	cameraCenter.y = clamped(cameraCenter.y - offset.y / (pitch * size.y), 0.f, 1.f);
+	allDirty = true;
+	changed();
+}
+
+void Board::zoom(float_t factor)
+{
+	cameraZoom = clamped(cameraZoom * factor, 1.f, MaxBoardZoom);
+	allDirty = true;
+	changed();
+}
+
+void Board::resetCamera()
+{
+	cameraCenter = { 0.5f, 0.5f };
+	cameraZoom = 1.f;
+	allDirty = true;
+	changed();
+}
+
+Color Board::summaryColor(int32_t value)
+{
+	return Palette::tileColor(value);
 }
 
 bool Board::update(size_t dt)
 {
+	previousAnimationTime = animationTime;
+	previousEffectTime = effectTime;
+
 	if (animate)
 	{
 		animationTime += dt;
 
-		if (animationTime >= AnimationLength)
+		if (animationTime >= AnimationLength || instant)
 		{
 			animate = false;
 			animationTime = 0;
-			for (size_t i = 0; i < size.y; ++i)
-				for (size_t j = 0; j < size.x; ++j)
-					animationData[i][j] = Vec2i();
+			mipsDirty = true;
+
+			effectTime = 0;
+			previousEffectTime = 0;
+			for (size_t i = 0; i < moves.size(); ++i)
+			{
+				Vec2i const& from = moves[i].from, & to = moves[i].to;
+				dirtyTiles[from.y][from.x] = true;
+				dirtyTiles[to.y][to.x] = true;
+
+				if (moves[i].merged && !instant)
+				{
+					TileEffect effect;
+					effect.idx = Vec2u(to);
+					effects.pushBack(effect);
+				}
+			}
 
 			return true;
 		}
 	}
+	else if (effects.size())
+	{
+		effectTime += dt;
+		if (effectTime >= EffectLength)
+			endEffects();
+	}
 	return false;
 }
 
+bool Board::finishAnimation()
+{
+	return animate && update(AnimationLength - animationTime);
+}
+
+void Board::setInstant(bool instant)
+{
+	this->instant = instant;
+	if (instant)
+		endEffects();
+}
+
 void Board::reset()
 {
+	clearAnimation();
+
 	for (size_t i = 0; i < size.y; ++i)
 		for (size_t j = 0; j < size.x; ++j)
-		{
 			data[i][j].setValue(0);
-			animationData[i][j] = {};
-		}
 	addNewTile();
 	fillPrevData();
 
-	animationTime = 0;
-	animate = false;
+	mipsDirty = true;
+	changed();
 }
 
 void Board::setDefaultShape(size_t n)
 {
 	data.clear();
 	prevData.clear();
-	animationData.clear();
+	dirtyTiles.clear();
 
 	for (size_t i = 0; i < n; i++)
 	{
@@ -179,15 +354,17 @@ void Board::setDefaultShape(size_t n)
 			data.back().pushBack(Tile());
 	}
 	prevData.resize(data.size());
-	animationData.resize(data.size());
+	dirtyTiles.resize(data.size());
 	for (size_t i = 0; i < data.size(); i++)
 	{
 		prevData[i].resize(data.front().size());
-		animationData[i].resize(data.front().size());
+		dirtyTiles[i].resize(data.front().size());
 	}
 
 	size = { data.front().size(), data.size() };
+	reserveAnimation();
 
+	resetCamera();
 	reset();
 }
 
@@ -223,10 +400,19 @@ int32_t Board::collapseTilesTo(Vec2i const& idx, Direction dir)
 			targetIdx = findIdxAfterShift(idx, dir);
 			if (targetIdx != idx)
 			{
-				animationData[idx.y][idx.x] = targetIdx - idx;
+				TileMove move;
+				move.tile = data[idx.y][idx.x];
+				move.from = idx;
+				move.to = targetIdx;
 
 				if (data[targetIdx.y][targetIdx.x].canMergeWith(data[idx.y][idx.x]))
+				{
+					// the tile merged with is the nearest one towards the edge, so if it moved, it was the last move
+					move.merged = data[targetIdx.y][targetIdx.x].getValue() > 0;
+					move.ontoStaticTile = move.merged && !(moves.size() && moves.back().to == targetIdx);
 					points += data[targetIdx.y][targetIdx.x].mergeWith(data[idx.y][idx.x]);
+				}
+				moves.pushBack(move);
 			}
 		}
 	}
@@ -234,6 +420,222 @@ int32_t Board::collapseTilesTo(Vec2i const& idx, Direction dir)
 	return points;
 }
 
+Vec2i Board::movePosition(TileMove const & move, Vec2i const & origin, int32_t pitch, size_t time) const
+{
+	return origin + move.from * pitch + Vec2i(Vec2f(move.to - move.from) * float_t(pitch) * float_t(time) / float_t(AnimationLength));
+}
+
+void Board::eraseMove(RenderTarget & target, TileMove const & move, Vec2i const & origin, int32_t pitch, int32_t tileSize, bool sliding) const
+{
+	Vec2i pos = movePosition(move, origin, pitch, drawnAnimationTime);
+	target.fillRect(pos, Vec2i(tileSize + 1, tileSize + 1), Palette::get(PaletteBackground));
+	target.invalidate(pos, Vec2i(tileSize + 1, tileSize + 1));
+
+	// the tile lies over at most two cells of its path
+	Vec2i step = move.to - move.from;
+	int32_t length = abs(step.x + step.y);
+	step = step / length;
+
+	float_t progress = float_t(length) * float_t(drawnAnimationTime) / float_t(AnimationLength);
+	int32_t first = minVal(int32_t(floorf(progress)), length), last = minVal(int32_t(ceilf(progress)), length);
+
+	Tile emptyTile;
+	emptyTile.setValue(0);
+
+	for (int32_t k = first; k <= last; ++k)
+	{
+		Vec2i cell = move.from + step * k;
+		if (!sliding)
+			dirtyTiles[cell.y][cell.x] = true;
+		else if (cell == move.to && move.ontoStaticTile)
+			drawTile(target, prevData[cell.y][cell.x], origin + cell * pitch, tileSize);
+		else
+			drawTile(target, emptyTile, origin + cell * pitch, tileSize);
+	}
+}
+
+void Board::drawEffects(RenderTarget & target, Vec2i const & origin, int32_t pitch, int32_t tileSize) const
+{
+	Vec2i screenSize = target.getSize();
+	float_t progress = float_t(interpolated(previousEffectTime, effectTime)) / float_t(EffectLength);
+
+	for (size_t i = 0; i < effects.size(); ++i)
+	{
+		Vec2i pos = origin + Vec2i(effects[i].idx) * pitch;
+		if (pos.x >= screenSize.x || pos.y >= screenSize.y || pos.x + tileSize < 0 || pos.y + tileSize < 0)
+			continue;
+
+		float_t scale = effects[i].spawned ? progress : MergeStartScale + (1.f - MergeStartScale) * progress;
+		int32_t scaledSize = int32_t(tileSize * scale);
+
+		target.fillRect(pos, Vec2i(tileSize + 1, tileSize + 1), Palette::get(PaletteBackground));
+		target.invalidate(pos, Vec2i(tileSize + 1, tileSize + 1));
+
+		// only the square, the number appears with the tile at its size
+		Tile tile = data[effects[i].idx.y][effects[i].idx.x];
+		tile.size = { scaledSize, scaledSize };
+		tile.Rectangle::draw(target, Transform(pos + Vec2i(tileSize - scaledSize, tileSize - scaledSize) / 2, {}, { 1.f, 1.f }));
+	}
+}
+
+void Board::endEffects()
+{
+	for (size_t i = 0; i < effects.size(); ++i)
+		dirtyTiles[effects[i].idx.y][effects[i].idx.x] = true;
+	effects.clear();
+}
+
+void Board::reserveAnimation()
+{
+	moves.reserve(size.x * size.y);
+	effects.reserve(size.x * size.y);
+}
+
+void Board::clearAnimation()
+{
+	moves.clear();
+	effects.clear();
+	animate = false;
+	animationTime = 0;
+	effectTime = 0;
+	previousAnimationTime = 0;
+	previousEffectTime = 0;
+	movesOnScreen = false;
+	allDirty = true;
+}
+
+size_t Board::interpolated(size_t previous, size_t current) const
+{
+	return previous + size_t(float_t(current - previous) * clamped(interpolation, 0.f, 1.f));
+}
+
+void Board::drawTile(RenderTarget & target, Tile const & tile, Vec2i const & pos, int32_t tileSize) const
+{
+	if (SDL_Surface* sprite = tileCache.get(tile, tileSize, target))
+		target.draw(sprite, Transform(pos, {}, { 1.f, 1.f }));
+	else
+	{
+		Tile temp = tile;
+		temp.size = { tileSize, tileSize };
+		temp.draw(target, Transform(pos, {}, { 1.f, 1.f }));
+	}
+}
+
+void Board::queueTile(RenderTarget & target, Tile const & tile, Vec2i const & pos, int32_t tileSize) const
+{
+	SpriteBlit blit;
+	if ((blit.sprite = tileCache.get(tile, tileSize, target)))
+	{
+		blit.pos = pos;
+		queuedTiles.pushBack(blit);
+	}
+	else
+		drawTile(target, tile, pos, tileSize);
+}
+
+void Board::drawQueuedTiles(RenderTarget & target) const
+{
+	target.drawSprites(queuedTiles.getData(), queuedTiles.size());
+	queuedTiles.clear();
+}
+
+float_t Board::getTilePitch() const
+{
+	return float_t(WinSize.y) / float_t(size.y) * 0.7f * cameraZoom * 1.2f;
+}
+
+void Board::visibleRange(float_t origin, float_t pitch, float_t extent, int32_t screenSize, size_t count, size_t & first, size_t & last)
+{
+	first = size_t(clamped(int32_t(floorf((-origin - extent) / pitch)) + 1, 0, int32_t(count)));
+	last = size_t(clamped(int32_t(floorf((float_t(screenSize) - origin) / pitch)) + 1, 0, int32_t(count)));
+}
+
+void Board::drawLod(RenderTarget & target, Vec2f const & topLeft, float_t pitch) const
+{
+	if (!allDirty && !mipsDirty)
+		return;
+	allDirty = false;
+
+	updateMips();
+
+	// the smallest level with blocks of at least a pixel
+	size_t level = 0;
+	float_t blockSize = pitch;
+	for (; blockSize < 1.f && level + 1 < mips.size(); ++level)
+		blockSize *= 2.f;
+
+	Vector<Color> const& mip = mips[level];
+	Vec2u const& mipSize = mipSizes[level];
+	Vec2i screenSize = target.getSize();
+
+	Vec2i boardPos(int32_t(floorf(topLeft.x)), int32_t(floorf(topLeft.y)));
+	Vec2i boardSize(int32_t(ceilf(pitch * size.x)), int32_t(ceilf(pitch * size.y)));
+	target.fillRect(boardPos, boardSize, Palette::get(PaletteBackground));
+	target.invalidate(boardPos, boardSize);
+
+	size_t firstCol = 0, lastCol = 0, firstRow = 0, lastRow = 0;
+	visibleRange(topLeft.x, blockSize, blockSize, screenSize.x, mipSize.x, firstCol, lastCol);
+	visibleRange(topLeft.y, blockSize, blockSize, screenSize.y, mipSize.y, firstRow, lastRow);
+
+	// edges are rounded down, so neighbouring blocks neither overlap nor leave gaps
+	for (size_t i = firstRow; i < lastRow; ++i)
+	{
+		int32_t top = int32_t(floorf(topLeft.y + blockSize * i));
+		int32_t bottom = int32_t(floorf(topLeft.y + blockSize * (i + 1)));
+
+		for (size_t j = firstCol; j < lastCol; ++j)
+		{
+			int32_t left = int32_t(floorf(topLeft.x + blockSize * j));
+			int32_t right = int32_t(floorf(topLeft.x + blockSize * (j + 1)));
+			target.fillRect({ left, top }, { right - left, bottom - top }, mip[i * mipSize.x + j]);
+		}
+	}
+}
+
+void Board::updateMips() const
+{
+	if (!mipsDirty)
+		return;
+	mipsDirty = false;
+
+	size_t levels = 1;
+	for (Vec2u levelSize = size; levelSize.x > 1 || levelSize.y > 1; ++levels)
+		levelSize = { (levelSize.x + 1) / 2, (levelSize.y + 1) / 2 };
+
+	mips.resize(levels);
+	mipSizes.resize(levels);
+
+	mipSizes[0] = size;
+	mips[0].resize(size.x * size.y);
+	for (size_t i = 0; i < size.y; ++i)
+		for (size_t j = 0; j < size.x; ++j)
+			mips[0][i * size.x + j] = summaryColor(data[i][j].isAWall() ? -1 : int32_t(data[i][j].getValue()));
+
+	// every block is the average of up to four blocks of the level below
+	for (size_t level = 1; level < levels; ++level)
+	{
+		Vec2u const& below = mipSizes[level - 1];
+		Vec2u& current = mipSizes[level];
+		current = { (below.x + 1) / 2, (below.y + 1) / 2 };
+		mips[level].resize(current.x * current.y);
+
+		for (size_t i = 0; i < current.y; ++i)
+			for (size_t j = 0; j < current.x; ++j)
+			{
+				uint32_t r = 0, g = 0, b = 0, n = 0;
+				for (size_t y = 2 * i; y < minVal(2 * i + 2, size_t(below.y)); ++y)
+					for (size_t x = 2 * j; x < minVal(2 * j + 2, size_t(below.x)); ++x, ++n)
+					{
+						Color const& c = mips[level - 1][y * below.x + x];
+						r += c.r;
+						g += c.g;
+						b += c.b;
+					}
+				mips[level][i * current.x + j] = { uint8_t(r / n), uint8_t(g / n), uint8_t(b / n) };
+			}
+	}
+}
+
 void Board::fillPrevData()
 {
 	for (int32_t i = 0; i < int32_t(size.y); ++i)
@@ -241,6 +643,11 @@ void Board::fillPrevData()
 			prevData[i][j] = data[i][j];
 }
 
+void Board::changed()
+{
+	version = uint32_t(SDL_AtomicAdd(&lastVersion, 1)) + 1;
+}
+
 int32_t Board::shiftTo(Direction direction)
 {
 	if (animate || !canShiftTo(direction))
@@ -250,6 +657,13 @@ int32_t Board::shiftTo(Direction direction)
 
 	fillPrevData();
 
+	// tiles of the last slide and effects cut short would stay on the screen as they are
+	if (movesOnScreen || effects.size())
+		allDirty = true;
+
+	effects.clear();
+	moves.clear();
+
 	if (direction == Direction::Right)
 		for (int32_t i = 0; i < int32_t(size.y); ++i)
 			points += collapseTilesTo({ 0, i }, direction);
@@ -268,6 +682,12 @@ int32_t Board::shiftTo(Direction direction)
 			data[i][j].confirmMerge();
 
 	animate = true;
+	previousAnimationTime = 0;
+	drawnAnimationTime = 0;
+	movesOnScreen = true;
+
+	++shiftCount;
+	changed();
 
 	return points;
 }
@@ -281,37 +701,158 @@ bool Board::canShiftTo(Direction dir) const
 	return false;
 }
 
+size_t Board::countEmptyTiles() const
+{
+	size_t count = 0;
+	for (size_t i = 0; i < size.y; ++i)
+		for (size_t j = 0; j < size.x; ++j)
+			count += !data[i][j].getValue() && !data[i][j].isAWall();
+	return count;
+}
+
 bool Board::addNewTile()
 {
-	Vec2u* freeIndices = new Vec2u[size.x * size.y];
-	size_t freeCount = 0;
+	size_t freeCount = countEmptyTiles();
+	if (!freeCount)
+		return false;
+
+	// the second pass stops at the chosen free tile, so nothing has to be stored
+	size_t chosen = rand() % freeCount;
 
 	for (int32_t i = 0; i < int32_t(size.y); ++i)
 		for (int32_t j = 0; j < int32_t(size.x); ++j)
-			if (!data[i][j].getValue() && !data[i][j].isAWall())
-				freeIndices[freeCount++] = Vec2u(j, i);
+			if (!data[i][j].getValue() && !data[i][j].isAWall() && !chosen--)
+				return addNewTileAt(Vec2u(j, i));
 
-	if (freeCount)
-	{
-		Vec2u idx = freeIndices[rand() % freeCount];
-		data[idx.y][idx.x].setValue(TileBaseValue);
-	}
+	return false;
+}
 
-	delete[] freeIndices;
-	return freeCount;
+bool Board::addNewTileAt(Vec2u const & idx)
+{
+	if (idx.x >= size.x || idx.y >= size.y || data[idx.y][idx.x].getValue() || data[idx.y][idx.x].isAWall())
+		return false;
+
+	data[idx.y][idx.x].setValue(TileBaseValue);
+	dirtyTiles[idx.y][idx.x] = true;
+	mipsDirty = true;
+	lastSpawn = idx;
+	changed();
+
+	if (instant)
+		return true;
+
+	TileEffect effect;
+	effect.idx = idx;
+	effect.spawned = true;
+	effects.pushBack(effect);
+	effectTime = 0;
+	previousEffectTime = 0;
+	return true;
 }
 
 bool Board::undo()
 {
+	endEffects();
+
 	bool diff = false;
 	for (int32_t i = 0; i < int32_t(size.y); ++i)
 		for (int32_t j = 0; j < int32_t(size.x); ++j)
-			if(diff |= (data[i][j].getValue() != prevData[i][j].getValue()))
+			if (diff |= (data[i][j].getValue() != prevData[i][j].getValue()))
+			{
 				data[i][j] = prevData[i][j];
+				dirtyTiles[i][j] = true;
+				mipsDirty = true;
+			}
 
+	if (diff)
+		changed();
 	return diff;
 }
 
+bool Board::copyStateFrom(Board const & other)
+{
+	bool reshaped = false;
+	bool newShift = other.shiftCount != shiftCount;
+
+	// the screen has to show the board from before the shift for the slide to be drawn over it
+	bool sameBase = true;
+
+	if (other.version != version)
+	{
+		if (other.size != size)
+		{
+			data = other.data;
+			prevData = other.prevData;
+			dirtyTiles.resize(other.size.y);
+			for (size_t i = 0; i < other.size.y; ++i)
+				dirtyTiles[i].resize(other.size.x);
+			size = other.size;
+			reserveAnimation();
+
+			allDirty = true;
+			reshaped = true;
+		}
+		else
+			for (size_t i = 0; i < size.y; ++i)
+				for (size_t j = 0; j < size.x; ++j)
+				{
+					Tile const& tile = other.data[i][j];
+					sameBase &= data[i][j].getValue() == other.prevData[i][j].getValue() && data[i][j].isAWall() == other.prevData[i][j].isAWall();
+
+					if (data[i][j].getValue() != tile.getValue() || data[i][j].isAWall() != tile.isAWall())
+					{
+						data[i][j] = tile;
+						dirtyTiles[i][j] = true;
+					}
+					prevData[i][j] = other.prevData[i][j];
+				}
+
+		if (cameraCenter != other.cameraCenter || cameraZoom != other.cameraZoom)
+		{
+			cameraCenter = other.cameraCenter;
+			cameraZoom = other.cameraZoom;
+			allDirty = true;
+		}
+
+		lastSpawn = other.lastSpawn;
+		mipsDirty = true;
+		version = other.version;
+	}
+
+	// tiles of the last slide and effects cut short would stay on the screen as they are, like in shiftTo
+	if (newShift)
+	{
+		if (!sameBase || movesOnScreen || effects.size())
+			allDirty = true;
+
+		moves = other.moves;
+		drawnAnimationTime = 0;
+		movesOnScreen = true;
+		shiftCount = other.shiftCount;
+	}
+	else if (moves.size() != other.moves.size())
+	{
+		// cleared by a reset or a load
+		if (movesOnScreen)
+			allDirty = true;
+		moves = other.moves;
+	}
+
+	// the cells of the effects are repainted, the ones still running are drawn over them again
+	if (!reshaped)
+		for (size_t i = 0; i < effects.size(); ++i)
+			dirtyTiles[effects[i].idx.y][effects[i].idx.x] = true;
+	effects = other.effects;
+
+	animate = other.animate;
+	animationTime = other.animationTime;
+	previousAnimationTime = other.previousAnimationTime;
+	effectTime = other.effectTime;
+	previousEffectTime = other.previousEffectTime;
+
+	return reshaped;
+}
+
 bool Board::saveTo(char const * src) const
 {
 	FILE* file = nullptr;
@@ -346,12 +887,14 @@ bool Board::loadFrom(char const * src)
 
 	if (file)
 	{
-		animationTime = 0;
-		animate = false;
+		clearAnimation();
 
 		data.clear();
 		prevData.clear();
-		animationData.clear();
+		dirtyTiles.clear();
+		mipsDirty = true;
+		resetCamera();
+		changed();
 
 		char c = 0;
 		char c2 = 0;
@@ -394,13 +937,14 @@ bool Board::loadFrom(char const * src)
 	}
 
 	size = { data.front().size(), data.size() };
+	reserveAnimation();
 
 	prevData.resize(size.y);
-	animationData.resize(size.y);
+	dirtyTiles.resize(size.y);
 	for (size_t i = 0; i < size.y; ++i)
 	{
 		prevData[i].resize(size.x);
-		animationData[i].resize(size.x);
+		dirtyTiles[i].resize(size.x);
 	}
 
 	bool anyWithValue = false;
@@ -8,14 +8,20 @@ static size_t const TileBaseValue = 2;
 
 static size_t const AnimationLength = 200;
 
-static Color const TileColor(Color::White);
+// merged and new tiles grow to their size after the slide
+static size_t const EffectLength = 100;
 
-static Color const WallTileColor(Color::Grey);
+static float_t const MergeStartScale = 0.7f;
 
 
 
 static char const WallCharacter = '#';
 
+// smaller tiles are drawn as blocks of color
+static int32_t const LodTileSize = 4;
+
+static float_t const MaxBoardZoom = 64.f;
+
 
 
 class Board : public Drawable, public Transformable
@@ -34,7 +40,7 @@ public:
 
 		void setAsWall(bool isWall);
 
-		void setValue(size_t newValue) { value = newValue; }
+		void setValue(size_t newValue);
 
 		// returns merged value
 		int32_t mergeWith(Tile& other);
@@ -53,6 +59,11 @@ public:
 
 		bool wasMerged() const { return merged; };
 
+	private:
+
+		// the fill follows the value
+		void updateColor();
+
 	private:
 
 		bool isWall = false;
@@ -62,6 +73,65 @@ public:
 		size_t value = 0;
 	};
 
+
+	// fully rendered tiles, keyed by value, wall and size
+	class TileCache
+	{
+		// a wall, an empty tile and one per power of two
+		static uint8_t const SlotCount = 2 + 32;
+
+	public:
+
+		TileCache() = default;
+
+		// sprites are never shared, a copy starts empty
+		TileCache(TileCache const&) {}
+
+		TileCache& operator=(TileCache const&) { return *this; }
+
+		~TileCache();
+
+
+		// returns nullptr for tiles that can't be cached
+		struct SDL_Surface* get(Tile const& tile, int32_t tileSize, class RenderTarget& target);
+
+		void clear();
+
+	private:
+
+		static int32_t slotOf(Tile const& tile);
+
+	private:
+
+		struct SDL_Surface* sprites[SlotCount] = {};
+
+		int32_t tileSize = 0;
+	};
+
+
+	// a tile that slid during the last shift
+	struct TileMove
+	{
+		// as it was before the shift
+		Tile tile;
+
+		Vec2i from;
+
+		Vec2i to;
+
+		bool merged = false;
+
+		// merged into a tile that didn't move, which stays under it until the slide ends
+		bool ontoStaticTile = false;
+	};
+
+	struct TileEffect
+	{
+		Vec2u idx;
+
+		bool spawned = false;
+	};
+
 public:
 
 	Board();
@@ -72,6 +142,37 @@ public:
 
 	bool update(size_t dt);
 
+	// jumps to the end of a running slide, returns true if there was one, like update does when it ends
+	bool finishAnimation();
+
+	// how far between the last two updates the next draw is, from 0 to 1
+	void setInterpolation(float_t alpha) { interpolation = alpha; }
+
+	// the next draw repaints the whole board instead of the changed tiles only
+	void invalidate() { allDirty = true; }
+
+	// a slide or an effect is running, so every frame looks different
+	bool isAnimating() const { return animate || effects.size() > 0; }
+
+	// no shift is possible until the slide ends
+	bool isSliding() const { return animate; }
+
+	// slides end with the first update and nothing grows after them, for games played faster than they can be watched
+	void setInstant(bool instant);
+
+
+	// moves the board along with the mouse, in pixels
+	void pan(Vec2i const& offset);
+
+	// zoom 1 fits the whole board
+	void zoom(float_t factor);
+
+	void resetCamera();
+
+
+	// one color for a whole tile, where there is no room for its number, negative for a wall
+	static Color summaryColor(int32_t value);
+
 	void reset();
 
 	void setDefaultShape(size_t n);
@@ -83,10 +184,23 @@ public:
 
 	bool addNewTile();
 
+	bool addNewTileAt(Vec2u const& idx);
+
+	Vec2u const& getLastSpawn() const { return lastSpawn; }
+
+	Vec2u const& getSize() const { return size; }
+
+	size_t countEmptyTiles() const;
+
 
 	bool undo();
 
 
+	// takes the game from a board of another thread, only what differs from the last copy is marked for repainting,
+	// returns true if the cells had to be reallocated
+	bool copyStateFrom(Board const& other);
+
+
 	bool saveTo(char const* src) const;
 
 	bool loadFrom(char const* src);
@@ -99,17 +213,109 @@ private:
 
 	void fillPrevData();
 
+	// the cells or the camera changed since the last copy was taken
+	void changed();
+
+	// top left corner of a moving tile after time of the slide
+	Vec2i movePosition(TileMove const& move, Vec2i const& origin, int32_t pitch, size_t time) const;
+
+	// covers the tile drawn at the last frame with the cells under it, or marks them dirty once the slide is over
+	void eraseMove(class RenderTarget& target, TileMove const& move, Vec2i const& origin, int32_t pitch, int32_t tileSize, bool sliding) const;
+
+	void drawEffects(class RenderTarget& target, Vec2i const& origin, int32_t pitch, int32_t tileSize) const;
+
+	// the tiles of the effects are drawn again at their size
+	void endEffects();
+
+	void clearAnimation();
+
+	// every tile moves and merges at most once a shift, so the animation never grows past the board
+	void reserveAnimation();
+
+	// time of a running slide or effect between the last two updates
+	size_t interpolated(size_t previous, size_t current) const;
+
+	void drawTile(class RenderTarget& target, Tile const& tile, Vec2i const& pos, int32_t tileSize) const;
+
+	// cached tiles wait in the batch, the rest is drawn right away
+	void queueTile(class RenderTarget& target, Tile const& tile, Vec2i const& pos, int32_t tileSize) const;
+
+	void drawQueuedTiles(class RenderTarget& target) const;
+
+
+	// tile and border, with the zoom applied
+	float_t getTilePitch() const;
+
+	// first and one past the last of count cells at least partially inside [0, screenSize)
+	static void visibleRange(float_t origin, float_t pitch, float_t extent, int32_t screenSize, size_t count, size_t& first, size_t& last);
+
+	// one block of color per tile, or per square of tiles when they are smaller than a pixel
+	void drawLod(class RenderTarget& target, Vec2f const& topLeft, float_t pitch) const;
+
+	void updateMips() const;
+
 private:
 
 	Vector<Vector<Tile>> data;
 
 	Vector<Vector<Tile>> prevData;
 
-	Vector<Vector<Vec2i>> animationData;
+	mutable Vector<Vector<bool>> dirtyTiles;
+
+	mutable bool allDirty = true;
+
+
+	// only the tiles that move are animated, in the order the shift moved them
+	Vector<TileMove> moves;
 
 	bool animate = false;
 
 	size_t animationTime = 0;
 
+	// the times before the last update, drawing interpolates from them
+	size_t previousAnimationTime = 0;
+
+	size_t previousEffectTime = 0;
+
+	float_t interpolation = 1.f;
+
+	// the moving tiles are on the screen as they were at this time of the slide
+	mutable size_t drawnAnimationTime = 0;
+
+	mutable bool movesOnScreen = false;
+
+
+	Vector<TileEffect> effects;
+
+	size_t effectTime = 0;
+
+	bool instant = false;
+
 	Vec2u size;
+
+	Vec2u lastSpawn;
+
+	mutable TileCache tileCache;
+
+	mutable Vector<SpriteBlit> queuedTiles;
+
+
+	// the point of the board in the middle of the view, as a fraction of its size
+	Vec2f cameraCenter = { 0.5f, 0.5f };
+
+	float_t cameraZoom = 1.f;
+
+
+	// level n has a color for every 2^n x 2^n square of tiles
+	mutable Vector<Vector<Color>> mips;
+
+	mutable Vector<Vec2u> mipSizes;
+
+	mutable bool mipsDirty = true;
+
+
+	// unique among all boards, so a copy can't take another board's state for the one it has
+	uint32_t version = 0;
+
+	uint32_t shiftCount = 0;
 };
\ No newline at end of file
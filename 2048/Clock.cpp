@@ -1,34 +1,64 @@
 #include "Clock.h"
 #include <stdio.h>
 
-SimulationClock::TimePoint_t SimulationClock::nextStep()
+SimulationClock::SimulationClock() : frequency(SDL_GetPerformanceFrequency())
 {
-	if (first == 0)
-		restart();
+	setFrameRate(DefaultFrameRate);
+}
+
+void SimulationClock::waitForFrame() const
+{
+	Uint64 frameEnd = last + frameTicks;
+	Uint64 now = SDL_GetPerformanceCounter();
 
-	int32_t sleepDuration = timestep - (SDL_GetTicks() - last);
+	if (first == 0 || now >= frameEnd)
+		return;
 
-	if(sleepDuration > 0)
-		SDL_Delay(sleepDuration);
+	TimePoint_t sleepDuration = toMilliseconds(frameEnd - now);
+	if (sleepDuration > FrameSleepMargin)
+		SDL_Delay(sleepDuration - FrameSleepMargin);
 
-	TimePoint_t now = SDL_GetTicks();
+	while (SDL_GetPerformanceCounter() < frameEnd);
+}
+
+bool SimulationClock::hasFramePassed() const
+{
+	return SDL_GetPerformanceCounter() >= last + frameTicks;
+}
 
-	deltaTime = now - last;
-	last = now;
+bool SimulationClock::waitFor(SDL_sem * sem, uint32_t timeout) const
+{
+	return SDL_SemWaitTimeout(sem, timeout) == 0;
+}
+
+SimulationClock::TimePoint_t SimulationClock::nextStep()
+{
+	if (first == 0)
+		restart();
+
+	// both ends are rounded the same way, so the deltas add up to the world time
+	TimePoint_t previous = getWorldTime();
+	last = SDL_GetPerformanceCounter();
+	deltaTime = getWorldTime() - previous;
 
 	return deltaTime;
 }
 
 void SimulationClock::restart()
 {
-	first = SDL_GetTicks();
+	first = SDL_GetPerformanceCounter();
 	last = first;
 	deltaTime = 0;
 }
 
 void SimulationClock::setWorldTime(uint32_t wTime)
 {
-	first = SDL_GetTicks() - wTime;
+	first = SDL_GetPerformanceCounter() - Uint64(wTime) * frequency / 1000;
+}
+
+void SimulationClock::setFrameRate(uint32_t fps)
+{
+	frameTicks = frequency / (fps ? fps : DefaultFrameRate);
 }
 
 SimulationClock::TimePoint_t SimulationClock::getDeltaTime() const
@@ -38,5 +68,53 @@ SimulationClock::TimePoint_t SimulationClock::getDeltaTime() const
 
 SimulationClock::TimePoint_t SimulationClock::getWorldTime() const
 {
-	return last - first;
+	return toMilliseconds(last - first);
+}
+
+SimulationClock::TimePoint_t SimulationClock::toMilliseconds(Uint64 ticks) const
+{
+	return TimePoint_t(ticks * 1000 / frequency);
+}
+
+
+
+VirtualClock::VirtualClock(TimePoint_t step) : step(step)
+{}
+
+void VirtualClock::setScript(Vector<TimePoint_t> const & steps)
+{
+	script = steps;
+	nextScriptStep = 0;
+}
+
+bool VirtualClock::waitFor(SDL_sem * sem, uint32_t timeout) const
+{
+	return SDL_SemTryWait(sem) == 0;
 }
+
+VirtualClock::TimePoint_t VirtualClock::nextStep()
+{
+	if (script.size())
+	{
+		deltaTime = script[nextScriptStep];
+		nextScriptStep = (nextScriptStep + 1) % script.size();
+	}
+	else
+		deltaTime = step;
+
+	worldTime += deltaTime;
+	return deltaTime;
+}
+
+void VirtualClock::restart()
+{
+	worldTime = 0;
+	deltaTime = 0;
+	nextScriptStep = 0;
+}
+
+void VirtualClock::setWorldTime(uint32_t wTime)
+{
+	worldTime = wTime;
+}
+
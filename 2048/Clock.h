@@ -2,32 +2,147 @@
 #include <corecrt_math.h>
 #include <stdint.h>
 #include "SDL-2.0.7/include/SDL_timer.h"
+#include "SDL-2.0.7/include/SDL_mutex.h"
+#include "Utility.h"
 
-class SimulationClock
+// used if the display doesn't report its refresh rate
+static uint32_t const DefaultFrameRate = 60;
+
+// SDL_Delay can oversleep, the last milliseconds of a frame are waited out on the counter
+static uint32_t const FrameSleepMargin = 2;
+
+
+// the time of the game and the pace of the frames, all times are in milliseconds
+class Clock
 {
+public:
+
 	using TimePoint_t = decltype(SDL_GetTicks());
 
+
+
+	virtual ~Clock() = default;
+
+
+	// sleeps until a frame has passed since the last step
+	virtual void waitForFrame() const = 0;
+
+	virtual bool hasFramePassed() const = 0;
+
+	// returns true if the semaphore was posted before the timeout
+	virtual bool waitFor(SDL_sem* sem, uint32_t timeout) const = 0;
+
+
+	virtual TimePoint_t nextStep() = 0;
+
+	virtual void restart() = 0;
+
+	virtual void setWorldTime(uint32_t wTime) = 0;
+
+	virtual void setFrameRate(uint32_t fps) = 0;
+
+
+	virtual TimePoint_t getDeltaTime() const = 0;
+
+	virtual TimePoint_t getWorldTime() const = 0;
+};
+
+
+
+// measures on the performance counter
+class SimulationClock : public Clock
+{
 public:
 
-	TimePoint_t nextStep();
+	SimulationClock();
+
+
+	void waitForFrame() const override;
+
+	bool hasFramePassed() const override;
+
+	bool waitFor(SDL_sem* sem, uint32_t timeout) const override;
+
+
+	TimePoint_t nextStep() override;
+
+	void restart() override;
+
+	void setWorldTime(uint32_t wTime) override;
 
-	void restart();
+	void setFrameRate(uint32_t fps) override;
 
-	void setWorldTime(uint32_t wTime);
 
+	TimePoint_t getDeltaTime() const override;
 
-	TimePoint_t getDeltaTime() const;
+	TimePoint_t getWorldTime() const override;
 
-	TimePoint_t getWorldTime() const;
+private:
+
+	TimePoint_t toMilliseconds(Uint64 ticks) const;
 
 private:
 
-	TimePoint_t first = 0;
+	Uint64 frequency = 0;
+
+	Uint64 first = 0;
+
+	Uint64 last = 0;
 
-	TimePoint_t last = 0;
+	Uint64 frameTicks = 0;
 
 	TimePoint_t deltaTime = 0;
 
-	TimePoint_t timestep = 1000 / 60;
+};
+
+
+
+// never sleeps, every step moves the time on by a fixed length or the next one of a script,
+// so the same steps give the same times on every run however fast they come
+class VirtualClock : public Clock
+{
+public:
+
+	explicit VirtualClock(TimePoint_t step);
+
+
+	// the steps are taken in turn and from the start again after the last one, none at all goes back to the fixed step
+	void setScript(Vector<TimePoint_t> const& steps);
+
+
+	// a frame passes with every step
+	void waitForFrame() const override {}
+
+	bool hasFramePassed() const override { return true; }
+
+	// takes a post if there is one, but doesn't wait for it
+	bool waitFor(SDL_sem* sem, uint32_t timeout) const override;
 
-};
\ No newline at end of file
+
+	TimePoint_t nextStep() override;
+
+	// the script starts over
+	void restart() override;
+
+	void setWorldTime(uint32_t wTime) override;
+
+	// the step is the frame
+	void setFrameRate(uint32_t fps) override {}
+
+
+	TimePoint_t getDeltaTime() const override { return deltaTime; }
+
+	TimePoint_t getWorldTime() const override { return worldTime; }
+
+private:
+
+	TimePoint_t step = 0;
+
+	Vector<TimePoint_t> script;
+
+	size_t nextScriptStep = 0;
+
+	TimePoint_t worldTime = 0;
+
+	TimePoint_t deltaTime = 0;
+};
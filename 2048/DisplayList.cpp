@@ -0,0 +1,198 @@
+#include "DisplayList.h"
+
+
+DisplayList::DisplayList() : RenderTarget(Vec2i(), nullptr)
+{}
+
+void DisplayList::replay(RenderTarget & target, Vec2i const & offset) const
+{
+	for (size_t i = 0; i < commands.size(); ++i)
+	{
+		Command const& command = commands[i];
+
+		if (command.type == Command::Type::Sprite)
+		{
+			Transform transform = command.transform;
+			transform.pos += offset;
+			target.draw(command.sprite, transform);
+		}
+		else if (command.type == Command::Type::Pixel)
+			target.drawPixel(command.pos + offset, command.color);
+		else if (command.type == Command::Type::Line)
+			target.drawLine(command.pos + offset, command.size + offset, command.color);
+		else if (command.type == Command::Type::Fill)
+			target.fillRect(command.pos + offset, command.size, command.color);
+		else if (command.type == Command::Type::Text)
+			target.beginText(command.color, command.size);
+		else if (command.type == Command::Type::Glyph)
+		{
+			SDL_Rect dest = { command.pos.x + offset.x, command.pos.y + offset.y, command.size.x, command.size.y };
+			target.drawGlyph(command.glyph, dest);
+		}
+	}
+}
+
+void DisplayList::reset()
+{
+	commands.clear();
+	dirtyRects.clear();
+	boundsMin = boundsMax = Vec2i();
+	bounded = false;
+}
+
+SDL_Surface * DisplayList::createSurface(Vec2u const & size) const
+{
+	return SDL_CreateRGBSurface(0, size.x, size.y, 32, 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
+}
+
+void DisplayList::draw(SDL_Surface * sprite, Transform const & transform)
+{
+	if (!sprite)
+		return;
+
+	Command command;
+	command.type = Command::Type::Sprite;
+	command.sprite = sprite;
+	command.transform = transform;
+
+	Vec2i size(int32_t(sprite->w * transform.scale.x), int32_t(sprite->h * transform.scale.y));
+	Vec2i pos = transform.pos - Vec2i(int32_t(size.x * transform.origin.x), int32_t(size.y * transform.origin.y));
+	record(command, pos, pos + size);
+}
+
+void DisplayList::drawPixel(Vec2i const & pos, Color const & color)
+{
+	Command command;
+	command.type = Command::Type::Pixel;
+	command.pos = pos;
+	command.color = color;
+	record(command, pos, pos + Vec2i(1, 1));
+}
+
+void DisplayList::drawLine(Vec2i const & start, Vec2i const & end, Color const & color)
+{
+	Command command;
+	command.type = Command::Type::Line;
+	command.pos = start;
+	command.size = end;
+	command.color = color;
+
+	Vec2i min(minVal(start.x, end.x), minVal(start.y, end.y));
+	Vec2i max(maxVal(start.x, end.x), maxVal(start.y, end.y));
+	record(command, min, max + Vec2i(1, 1));
+}
+
+void DisplayList::fillRect(Vec2i const & pos, Vec2i const & size, Color const & color)
+{
+	if (size.x <= 0 || size.y <= 0)
+		return;
+
+	Command command;
+	command.type = Command::Type::Fill;
+	command.pos = pos;
+	command.size = size;
+	command.color = color;
+	record(command, pos, pos + size);
+}
+
+void DisplayList::beginText(Color const & color, Vec2i const & glyphSize)
+{
+	Command command;
+	command.type = Command::Type::Text;
+	command.color = color;
+	command.size = glyphSize;
+
+	// changes no pixels, so it doesn't grow the bounds
+	commands.pushBack(command);
+}
+
+void DisplayList::drawGlyph(char c, SDL_Rect const & dest)
+{
+	Command command;
+	command.type = Command::Type::Glyph;
+	command.glyph = c;
+	command.pos = { dest.x, dest.y };
+	command.size = { dest.w, dest.h };
+	record(command, command.pos, command.pos + command.size);
+}
+
+void DisplayList::clear(Color const & color)
+{
+	reset();
+}
+
+void DisplayList::record(Command const & command, Vec2i const & min, Vec2i const & max)
+{
+	if (!bounded)
+	{
+		boundsMin = min;
+		boundsMax = max;
+		bounded = true;
+	}
+	else
+	{
+		boundsMin = Vec2i(minVal(boundsMin.x, min.x), minVal(boundsMin.y, min.y));
+		boundsMax = Vec2i(maxVal(boundsMax.x, max.x), maxVal(boundsMax.y, max.y));
+	}
+	commands.pushBack(command);
+}
+
+
+
+
+
+Layer::~Layer()
+{
+	RenderTarget::freeSurface(surface);
+}
+
+void Layer::record(Drawable const & drawable)
+{
+	drawable.draw(list);
+	RenderTarget::freeSurface(surface);
+	surface = nullptr;
+}
+
+void Layer::clear()
+{
+	list.reset();
+	RenderTarget::freeSurface(surface);
+	surface = nullptr;
+}
+
+void Layer::setOpacity(uint8_t value)
+{
+	if (opacity == value)
+		return;
+
+	opacity = value;
+	RenderTarget::freeSurface(surface);
+	surface = nullptr;
+}
+
+void Layer::draw(RenderTarget & target, Transform addTransform) const
+{
+	Vec2i boundsSize = list.getBoundsSize();
+	if (boundsSize.x <= 0 || boundsSize.y <= 0)
+		return;
+
+	if (!surface)
+	{
+		surface = target.createSurface(Vec2u(boundsSize));
+		if (!surface)
+			return;
+
+		// transparent wherever nothing was recorded
+		SDL_FillRect(surface, NULL, 0);
+		SDL_SetSurfaceBlendMode(surface, SDL_BLENDMODE_BLEND);
+		SDL_SetSurfaceAlphaMod(surface, opacity);
+
+		SurfaceTarget surfaceTarget(surface, target);
+		list.replay(surfaceTarget, -list.getBoundsPos());
+	}
+
+	addTransform *= transform;
+	Vec2i pos = addTransform.pos + list.getBoundsPos();
+	target.draw(surface, Transform(pos, {}, { 1.f, 1.f }));
+	target.invalidate(pos, boundsSize);
+}
@@ -0,0 +1,123 @@
+#pragma once
+#include "Window.h"
+
+
+// keeps what is drawn into it as commands, replay() draws the same into another target
+class DisplayList : public RenderTarget
+{
+	struct Command
+	{
+		enum class Type : uint8_t { Sprite, Pixel, Line, Fill, Text, Glyph };
+
+
+
+		Type type = Type::Fill;
+
+		SDL_Surface* sprite = nullptr;
+
+		Transform transform;
+
+		// position, line start or glyph destination
+		Vec2i pos;
+
+		// size, line end or glyph size
+		Vec2i size;
+
+		Color color;
+
+		char glyph = 0;
+	};
+
+public:
+
+	DisplayList();
+
+
+	void replay(RenderTarget& target, Vec2i const& offset = Vec2i()) const;
+
+	// drops the commands, the memory is kept for the next recording
+	void reset();
+
+	bool isEmpty() const { return !commands.size(); }
+
+	// of everything recorded, the size is zero for an empty list
+	Vec2i const& getBoundsPos() const { return boundsMin; }
+
+	Vec2i getBoundsSize() const { return boundsMax - boundsMin; }
+
+
+	SDL_Surface* createSurface(Vec2u const& size) const override;
+
+
+	// the sprite isn't copied, it has to outlive the list
+	void draw(SDL_Surface* sprite, Transform const& transform) override;
+
+	void drawPixel(Vec2i const& pos, Color const& color) override;
+
+	void drawLine(Vec2i const& start, Vec2i const& end, Color const& color) override;
+
+	void fillRect(Vec2i const& pos, Vec2i const& size, Color const& color) override;
+
+protected:
+
+	void beginText(Color const& color, Vec2i const& glyphSize) override;
+
+	void drawGlyph(char c, SDL_Rect const& dest) override;
+
+
+	void clear(Color const& color) override;
+
+	void display() override {}
+
+private:
+
+	void record(Command const& command, Vec2i const& min, Vec2i const& max);
+
+private:
+
+	Vector<Command> commands;
+
+	Vec2i boundsMin;
+
+	Vec2i boundsMax;
+
+	bool bounded = false;
+};
+
+
+
+// content that rarely changes, rasterized once into a surface and then drawn with a single blit
+class Layer : public Drawable, public Transformable
+{
+public:
+
+	Layer() = default;
+
+	Layer(Layer const&) = delete;
+
+	Layer& operator=(Layer const&) = delete;
+
+	~Layer();
+
+
+	// adds what the drawable draws, the layer is rasterized again on the next draw
+	void record(Drawable const& drawable);
+
+	void clear();
+
+	bool isEmpty() const { return list.isEmpty(); }
+
+	// 255 is opaque, the recorded content is blended with it
+	void setOpacity(uint8_t value);
+
+
+	void draw(RenderTarget& target, Transform addTransform = Transform()) const override;
+
+private:
+
+	DisplayList list;
+
+	mutable SDL_Surface* surface = nullptr;
+
+	uint8_t opacity = 255;
+};
@@ -12,12 +12,7 @@ void Pixel::draw(RenderTarget & target, Transform addTransform) const
 
 void Line::draw(RenderTarget & target, Transform addTransform) const
 {
-	Vec2f dir(Vec2f(end - start));
-	int32_t length = int32_t(dir.length());
-	dir.normalize();
-
-	for (Pixel pixel(start, color); (pixel.pos - Vec2f(start)).length() <= length; pixel.pos += dir)
-		pixel.draw(target);
+	target.drawLine(start, end, color);
 }
 
 void Rectangle::draw(RenderTarget & target, Transform addTransform) const
@@ -25,33 +20,22 @@ void Rectangle::draw(RenderTarget & target, Transform addTransform) const
 	addTransform *= transform;
 	addTransform.origin = transform.origin;
 
-	Line line;
-	line.color = outlineColor;
-
 	Vec2i realSize = Vec2i(int32_t(size.x * addTransform.scale.x), int32_t(size.y * addTransform.scale.y));
 	Vec2i topLeft = addTransform.pos - Vec2i(int32_t(realSize.x * addTransform.origin.x), int32_t(realSize.y * addTransform.origin.y));
 
-	line.start = topLeft;
-	line.end = topLeft + Vec2i(realSize.x, 0);
-	line.draw(target);
-
-	line.end = topLeft + Vec2i(0, realSize.y);
-	line.draw(target);
-
-	line.start = topLeft + realSize + Vec2i(0, 0);
-	line.end = topLeft + Vec2i(realSize.x, 0);
-	line.draw(target);
+	// the outline covers both corners, the fill is everything inside it
+	target.fillRect(topLeft, Vec2i(realSize.x + 1, 1), outlineColor);
+	target.fillRect(topLeft + Vec2i(0, realSize.y), Vec2i(realSize.x + 1, 1), outlineColor);
+	target.fillRect(topLeft + Vec2i(0, 1), Vec2i(1, realSize.y - 1), outlineColor);
+	target.fillRect(topLeft + Vec2i(realSize.x, 1), Vec2i(1, realSize.y - 1), outlineColor);
 
-	line.end = topLeft + Vec2i(0, realSize.y);
-	line.draw(target);
-
-
-	line.color = fillColor;
-	line.start = topLeft + Vec2i(1, 1);
-	line.end = topLeft + Vec2i(realSize.x - 1, 1);
+	target.fillRect(topLeft + Vec2i(1, 1), realSize - Vec2i(1, 1), fillColor);
+}
 
-	for (; line.start.y <= topLeft.y + realSize.y - 1; ++line.start.y, ++line.end.y)
-		line.draw(target);
+void Sprite::draw(RenderTarget & target, Transform addTransform) const
+{
+	addTransform.origin = transform.origin;
+	target.draw(surface, addTransform *= transform);
 }
 
 
@@ -60,6 +44,38 @@ Text::Text(char const * text, Color const & color) : color(color)
 	set(text);
 }
 
+Text::Text(Text && other)
+{
+	*this = static_cast<Text&&>(other);
+}
+
+Text & Text::operator=(Text && other)
+{
+	if (this == &other)
+		return *this;
+
+	free();
+
+	Transformable::operator=(other);
+	color = other.color;
+
+	if (other.str == other.inlineStr)
+	{
+		strcpy_s(inlineStr, other.str);
+		str = inlineStr;
+	}
+	else if (other.str)
+	{
+		// the heap buffer changes hands
+		str = other.str;
+		capacity = other.capacity;
+		other.str = nullptr;
+		other.capacity = TextInlineSize;
+	}
+
+	return *this;
+}
+
 Text::~Text()
 {
 	free();
@@ -75,26 +91,36 @@ void Text::set(char const * text)
 {
 	if (text)
 	{
-		size_t strSize = strlen(text) + 1;
-		alloc(strSize);
+		uint32_t strSize = uint32_t(strlen(text) + 1);
+		if (strSize > capacity)
+			alloc(strSize);
+		else if (!str)
+			str = inlineStr;
 		strcpy_s(str, strSize, text);
 	}
-	else free();
+	else if (str)
+	{
+		// the storage is kept for the next set
+		if (str == inlineStr)
+			str = nullptr;
+		else
+			str[0] = 0;
+	}
 }
 
 void Text::alloc(uint32_t size)
 {
 	free();
 	str = new char[size];
+	capacity = size;
 }
 
 void Text::free()
 {
-	if (str)
-	{
+	if (str && str != inlineStr)
 		delete[] str;
-		str = nullptr;
-	}
+	str = nullptr;
+	capacity = TextInlineSize;
 }
 
 
@@ -104,8 +130,8 @@ void Text::free()
 MessageBox::MessageBox()
 {
 	size = Vec2i(WinSize) / 3;
-	fillColor = Color::Black;
-	outlineColor = Color::Red;
+	fillColor = Palette::get(PaletteBackground);
+	outlineColor = Palette::get(PaletteMessageOutline);
 	setOrigin({ 0.5f, 0.5f });
 	setPosition(Vec2i(WinSize) / 2);
 
@@ -139,13 +165,15 @@ void MessageBox::draw(RenderTarget & target, Transform addTransform) const
 		title.set("Warning");
 	else if (type == Type::Error)
 		title.set("Error");
+	else if (type == Type::Question)
+		title.set("Question");
 
 	title.draw(target, addTransform);
 	text.draw(target, addTransform);
 
 	title.setOrigin({ 0.5f, 2.f });
 	title.setPosition({ size.x / 2, size.y });
-	title.set("Press Enter");
+	title.set(type == Type::Question ? "Y / N" : "Press Enter");
 
 	title.draw(target, addTransform);
 }
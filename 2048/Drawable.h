@@ -1,6 +1,7 @@
 #pragma once
 #include "Vec2.h"
 #include "Utility.h"
+#include "Palette.h"
 
 
 struct Transform
@@ -116,20 +117,54 @@ public:
 };
 
 
+class Sprite : public Drawable, public Transformable
+{
+public:
+
+	explicit Sprite(struct SDL_Surface* surface = nullptr) : surface(surface) {}
+
+
+	void draw(RenderTarget& target, Transform addTransform = Transform()) const override;
+
+
+public:
+
+	struct SDL_Surface* surface = nullptr;
+};
+
+
+struct SpriteBlit
+{
+	struct SDL_Surface* sprite = nullptr;
+
+	// of the top left corner, sprites in a batch are never scaled
+	Vec2i pos;
+};
+
+
+// including the terminating zero, longer strings go to the heap
+static uint32_t const TextInlineSize = 32;
+
+
 class Text : public Drawable, public Transformable
 {
 public:
 
-	Text(char const* text = nullptr, Color const & color = Color::White);
+	Text(char const* text = nullptr, Color const & color = Palette::get(PaletteText));
 
 	Text(Text const&) = delete;
 
+	Text(Text&& other);
+
+	Text& operator=(Text&& other);
+
 	~Text();
 
 
 	void draw(RenderTarget& target, Transform addTransform = Transform()) const override;
 
 
+	// reuses the current storage whenever the text fits in it
 	void set(char const* text);
 
 private:
@@ -140,17 +175,22 @@ private:
 
 public:
 
-	Color color = Color::White;
+	Color color = Palette::get(PaletteText);
 
 private:
 
+	// points either to inlineStr or to the heap, nullptr when no text is set
 	char* str = nullptr;
+
+	uint32_t capacity = TextInlineSize;
+
+	char inlineStr[TextInlineSize];
 };
 
 
 struct MessageBox : public Rectangle
 {
-	enum class Type { Info, Warning, Error, Count };
+	enum class Type { Info, Warning, Error, Question, Count };
 
 
 
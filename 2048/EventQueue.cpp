@@ -0,0 +1,29 @@
+#include "EventQueue.h"
+
+
+bool EventQueue::push(SDL_Event const & event, Uint64 received)
+{
+	uint32_t end = uint32_t(SDL_AtomicGet(&tail));
+	if (end - uint32_t(SDL_AtomicGet(&head)) == EventQueueSize)
+		return false;
+
+	entries[end % EventQueueSize].event = event;
+	entries[end % EventQueueSize].received = received;
+	SDL_MemoryBarrierRelease();
+	SDL_AtomicSet(&tail, int(end + 1));
+	return true;
+}
+
+bool EventQueue::pop(SDL_Event & event, Uint64 & received)
+{
+	uint32_t start = uint32_t(SDL_AtomicGet(&head));
+	if (start == uint32_t(SDL_AtomicGet(&tail)))
+		return false;
+
+	SDL_MemoryBarrierAcquire();
+	event = entries[start % EventQueueSize].event;
+	received = entries[start % EventQueueSize].received;
+	SDL_MemoryBarrierRelease();
+	SDL_AtomicSet(&head, int(start + 1));
+	return true;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include "SDL-2.0.7/include/SDL.h"
+
+
+// a power of two, so the positions can wrap around
+static uint32_t const EventQueueSize = 256;
+
+
+// passes SDL events from one thread to one other without locking, neither ever waits
+class EventQueue
+{
+	struct Entry
+	{
+		SDL_Event event;
+
+		// when the event was taken from SDL, on the performance counter
+		Uint64 received;
+	};
+
+public:
+
+	// returns false and drops the event if the queue is full
+	bool push(SDL_Event const& event, Uint64 received);
+
+	bool pop(SDL_Event& event, Uint64& received);
+
+private:
+
+	Entry entries[EventQueueSize];
+
+	// only the reader moves the head and only the writer the tail
+	SDL_atomic_t head = { 0 };
+
+	SDL_atomic_t tail = { 0 };
+};
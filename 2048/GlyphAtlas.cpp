@@ -0,0 +1,89 @@
+#include "GlyphAtlas.h"
+
+#include "Assert.h"
+
+
+GlyphAtlas::GlyphAtlas()
+{
+	ASSERT((charset = SDL_LoadBMP(CharsetPath)), "SDL_ERROR: Charset loading");
+	SDL_SetColorKey(charset, true, 0x000000);
+}
+
+GlyphAtlas::~GlyphAtlas()
+{
+	for (size_t i = 0; i < entries.size(); ++i)
+		SDL_FreeSurface(entries[i].surface);
+	SDL_FreeSurface(charset);
+}
+
+SDL_Surface * GlyphAtlas::get(Vec2i const & glyphSize, Color const & color)
+{
+	if (glyphSize.x <= 0 || glyphSize.y <= 0)
+		return nullptr;
+
+	++useCounter;
+
+	size_t oldest = 0;
+	for (size_t i = 0; i < entries.size(); ++i)
+	{
+		Entry& entry = entries[i];
+		if (entry.glyphSize == glyphSize && entry.color.r == color.r && entry.color.g == color.g && entry.color.b == color.b)
+		{
+			entry.lastUse = useCounter;
+			return entry.surface;
+		}
+		if (entry.lastUse < entries[oldest].lastUse)
+			oldest = i;
+	}
+
+	SDL_Surface* surface = build(glyphSize, color);
+	if (!surface)
+		return nullptr;
+
+	if (entries.size() < MaxGlyphAtlases)
+		entries.pushBack(Entry());
+	else
+	{
+		SDL_FreeSurface(entries[oldest].surface);
+		swap(entries[oldest], entries.back());
+	}
+
+	Entry& entry = entries.back();
+	entry.glyphSize = glyphSize;
+	entry.color = color;
+	entry.surface = surface;
+	entry.lastUse = useCounter;
+	return surface;
+}
+
+SDL_Rect GlyphAtlas::glyphRect(char c, Vec2i const & glyphSize)
+{
+	int32_t idx = c & 255;
+	return { (idx % 16) * glyphSize.x, (idx / 16) * glyphSize.y, glyphSize.x, glyphSize.y };
+}
+
+SDL_Surface * GlyphAtlas::build(Vec2i const & glyphSize, Color const & color) const
+{
+	// no alpha channel, the background is a color key that differs from the text
+	SDL_Surface* surface = SDL_CreateRGBSurface(0, 16 * glyphSize.x, 16 * glyphSize.y, 32, 0x00FF0000, 0x0000FF00, 0x000000FF, 0);
+	if (!surface)
+		return nullptr;
+
+	Color key = (color.r == 0xff && color.g == 0 && color.b == 0xff) ? Color::Black : Color{ 0xff, 0, 0xff };
+	Uint32 mappedKey = key.sdlLike(surface);
+	SDL_FillRect(surface, NULL, mappedKey);
+
+	// glyph by glyph, so the scaling never bleeds into the neighbours
+	SDL_SetSurfaceColorMod(charset, color.r, color.g, color.b);
+	for (int32_t c = 0; c < 256; ++c)
+	{
+		SDL_Rect src = glyphRect(char(c), { CharsetGlyphSize, CharsetGlyphSize });
+		SDL_Rect dest = glyphRect(char(c), glyphSize);
+		SDL_BlitScaled(charset, &src, surface, &dest);
+	}
+	SDL_SetSurfaceColorMod(charset, 0xff, 0xff, 0xff);
+
+	// not RLE encoded, the blitter reads the pixels
+	SDL_SetColorKey(surface, true, mappedKey);
+	return surface;
+}
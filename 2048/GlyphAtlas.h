@@ -0,0 +1,58 @@
+#pragma once
+#include "SDL-2.0.7/include/SDL.h"
+#include "Vec2.h"
+
+
+static char const* const CharsetPath = "./cs8x8.bmp";
+
+static int32_t const CharsetGlyphSize = 8;
+
+static size_t const MaxGlyphAtlases = 16;
+
+
+
+// the charset scaled and colored once per (glyph size, color), so drawing a glyph is a plain blit
+class GlyphAtlas
+{
+	struct Entry
+	{
+		Vec2i glyphSize;
+
+		Color color;
+
+		SDL_Surface* surface = nullptr;
+
+		uint32_t lastUse = 0;
+	};
+
+public:
+
+	GlyphAtlas();
+
+	GlyphAtlas(GlyphAtlas const&) = delete;
+
+	GlyphAtlas& operator=(GlyphAtlas const&) = delete;
+
+	~GlyphAtlas();
+
+
+	// glyphs are laid out like in the charset, see glyphRect
+	SDL_Surface* get(Vec2i const& glyphSize, Color const& color);
+
+	SDL_Surface* getCharset() const { return charset; }
+
+
+	static SDL_Rect glyphRect(char c, Vec2i const& glyphSize);
+
+private:
+
+	SDL_Surface* build(Vec2i const& glyphSize, Color const& color) const;
+
+private:
+
+	SDL_Surface* charset = nullptr;
+
+	Vector<Entry> entries;
+
+	uint32_t useCounter = 0;
+};
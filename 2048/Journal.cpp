@@ -0,0 +1,322 @@
+#include "Journal.h"
+#include <stdio.h>
+#include <io.h>
+
+
+static bool readHeader(FILE* file, JournalRecord& header)
+{
+	return fread(&header, sizeof(header), 1, file) == 1 && header.type == JournalRecord::Type::Checkpoint;
+}
+
+static void checkpointPath(char(&path)[32], uint32_t seq)
+{
+	sprintf_s(path, "%s.%u", JournalPath, seq);
+}
+
+
+
+Journal::~Journal()
+{
+	if (worker)
+	{
+		SDL_AtomicSet(&quitting, 1);
+		SDL_WaitThread(worker, nullptr);
+		SDL_DestroyMutex(mutex);
+	}
+}
+
+void Journal::checkpoint(Board const & board, size_t points, size_t worldTime)
+{
+	if (disabled)
+		return;
+
+	if (!worker)
+	{
+		// continues the numbering of the previous journal
+		FILE* file = nullptr;
+		fopen_s(&file, JournalPath, "rb");
+		if (file)
+		{
+			JournalRecord header;
+			if (readHeader(file, header))
+				seq = header.seq;
+			fclose(file);
+		}
+
+		mutex = SDL_CreateMutex();
+		worker = SDL_CreateThread(workerMain, "journal", this);
+	}
+
+	started = worker != nullptr;
+
+	// the worker is copying the previous snapshot, records are dropped until the next try
+	if (SDL_TryLockMutex(mutex) != 0)
+	{
+		lost = true;
+		return;
+	}
+
+	// every checkpoint gets its own number, so a board file is never rewritten while referenced
+	snapshot = board;
+	snapshotRecord.seq = ++seq;
+	snapshotRecord.points = uint32_t(points);
+	snapshotRecord.worldTime = uint32_t(worldTime);
+	snapshotPending = true;
+	SDL_UnlockMutex(mutex);
+
+	lost = false;
+	movesSinceCheckpoint = 0;
+}
+
+bool Journal::needsCheckpoint()
+{
+	if (SDL_AtomicSet(&checkpointFailed, 0))
+		lost = true;
+
+	return started && (lost || movesSinceCheckpoint >= CheckpointInterval);
+}
+
+void Journal::recordMove(Direction direction, size_t points, size_t worldTime)
+{
+	JournalRecord record;
+	record.type = JournalRecord::Type::Move;
+	record.direction = direction;
+	record.points = uint32_t(points);
+	record.worldTime = uint32_t(worldTime);
+	append(record);
+
+	++movesSinceCheckpoint;
+}
+
+void Journal::recordSpawn(Vec2u const & idx, size_t points, size_t worldTime)
+{
+	JournalRecord record;
+	record.type = JournalRecord::Type::Spawn;
+	record.spawn = idx;
+	record.points = uint32_t(points);
+	record.worldTime = uint32_t(worldTime);
+	append(record);
+}
+
+void Journal::recordUndo(size_t points, size_t worldTime)
+{
+	JournalRecord record;
+	record.type = JournalRecord::Type::Undo;
+	record.points = uint32_t(points);
+	record.worldTime = uint32_t(worldTime);
+	append(record);
+}
+
+bool Journal::canResume()
+{
+	FILE* file = nullptr;
+	fopen_s(&file, JournalPath, "rb");
+
+	if (!file)
+		return false;
+
+	JournalRecord header;
+	bool valid = readHeader(file, header);
+	fclose(file);
+
+	char path[32];
+	checkpointPath(path, header.seq);
+	fopen_s(&file, path, "r");
+
+	if (!file)
+		return false;
+
+	fclose(file);
+	return valid;
+}
+
+bool Journal::replay(Board & board, size_t & points, size_t & worldTime)
+{
+	FILE* file = nullptr;
+	fopen_s(&file, JournalPath, "rb");
+
+	if (!file)
+		return false;
+
+	JournalRecord header;
+	char path[32];
+
+	if (!readHeader(file, header) || (checkpointPath(path, header.seq), !board.loadFrom(path)))
+	{
+		fclose(file);
+		return false;
+	}
+
+	points = header.points;
+	worldTime = header.worldTime;
+
+	// a torn record at the end is simply not read
+	for (JournalRecord record; fread(&record, sizeof(record), 1, file) == 1;)
+	{
+		// already part of the checkpointed board
+		if (record.seq <= header.seq)
+			continue;
+
+		if (record.type == JournalRecord::Type::Move)
+		{
+			if (board.shiftTo(record.direction) >= 0)
+				board.update(AnimationLength);
+		}
+		else if (record.type == JournalRecord::Type::Spawn)
+			board.addNewTileAt(record.spawn);
+		else if (record.type == JournalRecord::Type::Undo)
+			board.undo();
+
+		points = record.points;
+		worldTime = record.worldTime;
+	}
+
+	fclose(file);
+	return true;
+}
+
+void Journal::append(JournalRecord & record)
+{
+	if (!started || lost)
+		return;
+
+	uint32_t h = uint32_t(SDL_AtomicGet(&head));
+
+	// the worker fell behind, the next checkpoint makes up for the missing records
+	if (h - uint32_t(SDL_AtomicGet(&tail)) == JournalCapacity)
+	{
+		lost = true;
+		return;
+	}
+
+	record.seq = ++seq;
+	ring[h & (JournalCapacity - 1)] = record;
+	SDL_AtomicSet(&head, int(h + 1));
+}
+
+void Journal::work()
+{
+	size_t batchSize = 0;
+
+	FILE* file = nullptr;
+	uint32_t lastSync = SDL_GetTicks();
+	bool unsynced = false;
+
+	for (bool quit = false; !quit; )
+	{
+		quit = SDL_AtomicGet(&quitting) != 0;
+
+		// the head goes first, a record it covers was appended after any checkpoint it's newer than,
+		// so that checkpoint is already pending and the record can't end up in the file it replaces
+		uint32_t t = uint32_t(SDL_AtomicGet(&tail));
+		uint32_t h = uint32_t(SDL_AtomicGet(&head));
+
+		SDL_LockMutex(mutex);
+		bool pending = snapshotPending;
+		uint32_t pendingSeq = snapshotRecord.seq;
+		SDL_UnlockMutex(mutex);
+
+		for (; t != h; ++t)
+		{
+			JournalRecord const& record = ring[t & (JournalCapacity - 1)];
+
+			// everything written so far is covered by the checkpoint
+			if (pending && record.seq > pendingSeq)
+			{
+				writeCheckpoint(file);
+				pending = false;
+				batchSize = 0;
+			}
+			batch[batchSize++] = record;
+		}
+		SDL_AtomicSet(&tail, int(t));
+
+		if (pending)
+		{
+			writeCheckpoint(file);
+			batchSize = 0;
+		}
+
+		if (file && batchSize)
+		{
+			fwrite(batch, sizeof(*batch), batchSize, file);
+			fflush(file);
+			unsynced = true;
+		}
+		batchSize = 0;
+
+		if (file && unsynced && (quit || SDL_GetTicks() - lastSync >= JournalSyncInterval))
+		{
+			_commit(_fileno(file));
+			lastSync = SDL_GetTicks();
+			unsynced = false;
+		}
+
+		if (!quit)
+			SDL_Delay(JournalFlushInterval);
+	}
+
+	if (file)
+		fclose(file);
+}
+
+void Journal::writeCheckpoint(FILE *& file)
+{
+	char path[32];
+	JournalRecord header;
+
+	// only the copy is made under the lock, the game never waits for the disk
+	SDL_LockMutex(mutex);
+	header = snapshotRecord;
+	written = snapshot;
+	snapshotPending = false;
+	SDL_UnlockMutex(mutex);
+
+	// the records after a lost checkpoint would be replayed onto the board of the previous one
+	if (file)
+	{
+		fclose(file);
+		file = nullptr;
+	}
+
+	checkpointPath(path, header.seq);
+	if (!written.saveTo(path))
+	{
+		SDL_AtomicSet(&checkpointFailed, 1);
+		return;
+	}
+
+	// the previous board stays until the new header is on the disk
+	JournalRecord previous;
+	bool hadPrevious = false;
+	fopen_s(&file, JournalPath, "rb");
+	if (file)
+	{
+		hadPrevious = readHeader(file, previous);
+		fclose(file);
+	}
+
+	fopen_s(&file, JournalPath, "wb");
+	if (!file)
+	{
+		remove(path);
+		SDL_AtomicSet(&checkpointFailed, 1);
+		return;
+	}
+
+	fwrite(&header, sizeof(header), 1, file);
+	fflush(file);
+	_commit(_fileno(file));
+
+	if (hadPrevious && previous.seq != header.seq)
+	{
+		checkpointPath(path, previous.seq);
+		remove(path);
+	}
+}
+
+int Journal::workerMain(void * journal)
+{
+	((Journal*)journal)->work();
+	return 0;
+}
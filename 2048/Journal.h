@@ -0,0 +1,136 @@
+#pragma once
+#include "SDL-2.0.7/include/SDL.h"
+#include "Board.h"
+
+
+// the checkpointed board is stored next to it as "journal.<seq>"
+static char const* const JournalPath = "journal";
+
+// power of two
+static uint32_t const JournalCapacity = 1024;
+
+// in moves
+static uint32_t const CheckpointInterval = 256;
+
+// in milliseconds
+static uint32_t const JournalFlushInterval = 50;
+
+static uint32_t const JournalSyncInterval = 1000;
+
+
+
+struct JournalRecord
+{
+	enum class Type : uint8_t { Checkpoint, Move, Spawn, Undo };
+
+
+
+	uint32_t seq = 0;
+
+	Type type = Type::Checkpoint;
+
+	Direction direction = Direction::Count;
+
+	Vec2u spawn;
+
+	// totals after the record was applied
+	uint32_t points = 0;
+
+	uint32_t worldTime = 0;
+};
+
+
+
+// appends every move to a lock-free ring, a worker thread writes it out in batches
+class Journal
+{
+public:
+
+	Journal() = default;
+
+	Journal(Journal const&) = delete;
+
+	Journal& operator=(Journal const&) = delete;
+
+	~Journal();
+
+
+	// starts a new journal from the board, records are dropped until the first checkpoint,
+	// it is retried through needsCheckpoint when the worker holds the snapshot
+	void checkpoint(Board const& board, size_t points, size_t worldTime);
+
+	// also true once the worker failed to write the last checkpoint
+	bool needsCheckpoint();
+
+	// no checkpoint is taken from then on, so every record is dropped and nothing is written
+	void disable() { disabled = true; }
+
+
+	void recordMove(Direction direction, size_t points, size_t worldTime);
+
+	void recordSpawn(Vec2u const& idx, size_t points, size_t worldTime);
+
+	void recordUndo(size_t points, size_t worldTime);
+
+
+	static bool canResume();
+
+	// rebuilds the game from the last checkpoint and the records written after it
+	static bool replay(Board& board, size_t& points, size_t& worldTime);
+
+private:
+
+	void append(JournalRecord& record);
+
+
+	void work();
+
+	void writeCheckpoint(FILE*& file);
+
+	static int workerMain(void* journal);
+
+private:
+
+	// owned by the frame thread
+	uint32_t seq = 0;
+
+	// spawns and undos don't count towards CheckpointInterval
+	uint32_t movesSinceCheckpoint = 0;
+
+	bool started = false;
+
+	bool lost = false;
+
+	bool disabled = false;
+
+
+	JournalRecord ring[JournalCapacity];
+
+	SDL_atomic_t head = { 0 };
+
+	SDL_atomic_t tail = { 0 };
+
+
+	// owned by the worker
+	JournalRecord batch[JournalCapacity];
+
+	Board written;
+
+
+	// guarded by the mutex
+	Board snapshot;
+
+	JournalRecord snapshotRecord;
+
+	bool snapshotPending = false;
+
+
+	SDL_mutex* mutex = nullptr;
+
+	SDL_Thread* worker = nullptr;
+
+	SDL_atomic_t quitting = { 0 };
+
+	// set by the worker, records are dropped until the game takes another checkpoint
+	SDL_atomic_t checkpointFailed = { 0 };
+};
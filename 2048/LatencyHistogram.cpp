@@ -0,0 +1,63 @@
+#include "LatencyHistogram.h"
+
+
+LatencyHistogram::LatencyHistogram(char const * name) : name(name)
+{}
+
+void LatencyHistogram::record(float_t milliseconds)
+{
+	milliseconds = maxVal(milliseconds, 0.f);
+
+	++buckets[minVal(uint32_t(milliseconds), LatencyBucketCount - 1)];
+	++count;
+	total += milliseconds;
+	max = maxVal(max, milliseconds);
+}
+
+void LatencyHistogram::clear()
+{
+	for (uint32_t i = 0; i < LatencyBucketCount; ++i)
+		buckets[i] = 0;
+	count = 0;
+	total = 0.f;
+	max = 0.f;
+}
+
+uint32_t LatencyHistogram::getPercentile(float_t fraction) const
+{
+	if (!count)
+		return 0;
+
+	uint32_t rank = uint32_t(ceilf(fraction * float_t(count)));
+	uint32_t seen = 0;
+
+	for (uint32_t i = 0; i < LatencyBucketCount; ++i)
+		if ((seen += buckets[i]) >= rank)
+			return i + 1;
+	return LatencyBucketCount;
+}
+
+void LatencyHistogram::print() const
+{
+	if (!count)
+		return;
+
+	printf("%s: %u samples, mean %.1f ms, p50 %u ms, p90 %u ms, p99 %u ms, max %.1f ms\n",
+		name, count, getMean(), getPercentile(0.5f), getPercentile(0.9f), getPercentile(0.99f), max);
+
+	uint32_t highest = 0;
+	for (uint32_t i = 0; i < LatencyBucketCount; ++i)
+		highest = maxVal(highest, buckets[i]);
+
+	char bar[LatencyBarWidth + 1];
+	for (uint32_t i = 0; i < LatencyBucketCount; ++i)
+		if (buckets[i])
+		{
+			uint32_t width = maxVal(buckets[i] * LatencyBarWidth / highest, 1u);
+			for (uint32_t j = 0; j < width; ++j)
+				bar[j] = '#';
+			bar[width] = '\0';
+
+			printf("%s%3u ms %-*s %u\n", i + 1 == LatencyBucketCount ? ">" : " ", i, int(LatencyBarWidth), bar, buckets[i]);
+		}
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include "Utility.h"
+
+
+// a bucket per millisecond, the last one takes everything longer
+static uint32_t const LatencyBucketCount = 256;
+
+// the width of the longest bar of a printed histogram
+static uint32_t const LatencyBarWidth = 50;
+
+
+
+// counts how long something took, for percentiles and a printout
+class LatencyHistogram
+{
+public:
+
+	explicit LatencyHistogram(char const* name);
+
+
+	void record(float_t milliseconds);
+
+	void clear();
+
+
+	// the upper end of the bucket the fraction of the records falls into, 0 if there are none
+	uint32_t getPercentile(float_t fraction) const;
+
+	uint32_t getCount() const { return count; }
+
+	float_t getMean() const { return count ? total / float_t(count) : 0.f; }
+
+	float_t getMax() const { return max; }
+
+
+	// the summary and a bar per bucket that has any records, nothing if it's empty
+	void print() const;
+
+private:
+
+	char const* name = nullptr;
+
+	uint32_t buckets[LatencyBucketCount] = {};
+
+	uint32_t count = 0;
+
+	float_t total = 0.f;
+
+	float_t max = 0.f;
+};
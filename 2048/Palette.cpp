@@ -0,0 +1,55 @@
+#include "Palette.h"
+
+
+static Color const Colors[PaletteSize] = {
+	{ 0x00, 0x00, 0x00 },
+	{ 0x60, 0x60, 0x60 },
+	{ 0x20, 0x20, 0x20 },
+	{ 0xbb, 0xad, 0xa0 },
+	{ 0x77, 0x6e, 0x65 },
+	{ 0xff, 0xff, 0xff },
+	{ 0xff, 0x00, 0x00 },
+
+	// from 2 to 2^16
+	{ 0xee, 0xe4, 0xda },
+	{ 0xed, 0xe0, 0xc8 },
+	{ 0xf2, 0xb1, 0x79 },
+	{ 0xf5, 0x95, 0x63 },
+	{ 0xf6, 0x7c, 0x5f },
+	{ 0xf6, 0x5e, 0x3b },
+	{ 0xed, 0xcf, 0x72 },
+	{ 0xed, 0xcc, 0x61 },
+	{ 0xed, 0xc8, 0x50 },
+	{ 0xed, 0xc5, 0x3f },
+	{ 0xed, 0xc2, 0x2e },
+	{ 0xb7, 0x84, 0xab },
+	{ 0xa6, 0x61, 0xa0 },
+	{ 0x8e, 0x44, 0x92 },
+	{ 0x6b, 0x35, 0x7a },
+	{ 0x3c, 0x3a, 0x32 },
+};
+
+
+
+Color Palette::get(uint8_t entry)
+{
+	if (entry >= PaletteSize)
+		return Color();
+
+	Color color = Colors[entry];
+	color.paletteEntry = entry;
+	return color;
+}
+
+uint8_t Palette::tileEntry(int32_t value)
+{
+	if (value < 0)
+		return PaletteWall;
+	if (value == 0)
+		return PaletteEmpty;
+
+	uint8_t entry = PaletteFirstTile;
+	for (; value > 2 && entry < PaletteSize - 1; value /= 2)
+		++entry;
+	return entry;
+}
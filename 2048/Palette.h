@@ -0,0 +1,40 @@
+#pragma once
+#include "Utility.h"
+
+
+static uint8_t const PaletteBackground = 0;
+
+static uint8_t const PaletteWall = 1;
+
+static uint8_t const PaletteEmpty = 2;
+
+static uint8_t const PaletteOutline = 3;
+
+static uint8_t const PaletteTileText = 4;
+
+static uint8_t const PaletteText = 5;
+
+static uint8_t const PaletteMessageOutline = 6;
+
+// the tile of value 2^n has PaletteFirstTile + n - 1, the last one is used for everything bigger
+static uint8_t const PaletteFirstTile = 7;
+
+static uint8_t const PaletteTileCount = 16;
+
+static uint8_t const PaletteSize = PaletteFirstTile + PaletteTileCount;
+
+
+
+// every color used by the game, targets convert them into their pixel format once
+class Palette
+{
+public:
+
+	// the color remembers its entry, so a target can use the converted value
+	static Color get(uint8_t entry);
+
+	// walls are negative
+	static uint8_t tileEntry(int32_t value);
+
+	static Color tileColor(int32_t value) { return get(tileEntry(value)); }
+};
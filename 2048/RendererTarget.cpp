@@ -0,0 +1,144 @@
+#include "RendererTarget.h"
+
+#include "Assert.h"
+
+
+RendererTarget::RendererTarget(SDL_Renderer * renderer, WindowProperties const & prop) : RenderTarget(Vec2i(prop.size), new GlyphAtlas(), true), renderer(renderer)
+{
+	canvas = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, prop.size.x, prop.size.y);
+
+	// white glyphs tinted per string with the color mod, the texture does the scaling
+	ASSERT((charsetTexture = SDL_CreateTextureFromSurface(renderer, glyphs->getCharset())), "SDL_ERROR: Glyph texture creation");
+
+	SDL_SetRenderTarget(renderer, canvas);
+
+	dirtyRects.reserve(MaxDirtyRects);
+	batchRects.reserve(RendererBatchSize);
+}
+
+RendererTarget::~RendererTarget()
+{
+	SDL_SetRenderTarget(renderer, NULL);
+	SDL_DestroyTexture(charsetTexture);
+	SDL_DestroyTexture(canvas);
+}
+
+SDL_Surface * RendererTarget::createSurface(Vec2u const & size) const
+{
+	return SDL_CreateRGBSurface(0, size.x, size.y, 32, 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
+}
+
+void RendererTarget::draw(SDL_Surface * sprite, Transform const & transform)
+{
+	if (!sprite)
+		return;
+
+	if (!sprite->userdata && !(sprite->userdata = SDL_CreateTextureFromSurface(renderer, sprite)))
+		return;
+
+	flush();
+
+	SDL_Rect dest;
+	dest.w = int32_t(sprite->w * transform.scale.x);
+	dest.h = int32_t(sprite->h * transform.scale.y);
+	dest.x = int(transform.pos.x - dest.w * transform.origin.x);
+	dest.y = int(transform.pos.y - dest.h * transform.origin.y);
+
+	SDL_RenderCopy(renderer, (SDL_Texture*)sprite->userdata, NULL, &dest);
+}
+
+void RendererTarget::drawPixel(Vec2i const & pos, Color const & color)
+{
+	SDL_Rect rect = { pos.x, pos.y, 1, 1 };
+	batch(rect, color);
+}
+
+void RendererTarget::drawLine(Vec2i const & start, Vec2i const & end, Color const & color)
+{
+	Vec2i a = start, b = end;
+	if (!clipLine(a, b, { clip.x, clip.y }, Vec2i(clip.x + clip.w - 1, clip.y + clip.h - 1)))
+		return;
+
+	// straight lines join the batch of fills
+	if (a.x == b.x || a.y == b.y)
+	{
+		fillRect({ minVal(a.x, b.x), minVal(a.y, b.y) }, { abs(b.x - a.x) + 1, abs(b.y - a.y) + 1 }, color);
+		return;
+	}
+
+	flush();
+	SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, 255);
+	SDL_RenderDrawLine(renderer, a.x, a.y, b.x, b.y);
+}
+
+void RendererTarget::fillRect(Vec2i const & pos, Vec2i const & size, Color const & color)
+{
+	if (size.x > 0 && size.y > 0)
+	{
+		SDL_Rect rect = { pos.x, pos.y, size.x, size.y };
+		batch(rect, color);
+	}
+}
+
+void RendererTarget::setClip(Vec2i const & pos, Vec2i const & size)
+{
+	// the batched fills belong to the previous clip
+	flush();
+	RenderTarget::setClip(pos, size);
+	SDL_RenderSetClipRect(renderer, &clip);
+}
+
+void RendererTarget::beginText(Color const & color, Vec2i const & glyphSize)
+{
+	flush();
+	SDL_SetTextureColorMod(charsetTexture, color.r, color.g, color.b);
+}
+
+void RendererTarget::drawGlyph(char c, SDL_Rect const & dest)
+{
+	SDL_Rect src = GlyphAtlas::glyphRect(c, { CharsetGlyphSize, CharsetGlyphSize });
+	SDL_RenderCopy(renderer, charsetTexture, &src, &dest);
+}
+
+void RendererTarget::clear(Color const & color)
+{
+	batchRects.clear();
+	SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, 255);
+	SDL_RenderClear(renderer);
+}
+
+void RendererTarget::display()
+{
+	flush();
+
+	if (!isDirty())
+		return;
+	dirtyRects.clear();
+
+	SDL_SetRenderTarget(renderer, NULL);
+	SDL_RenderCopy(renderer, canvas, NULL, NULL);
+	SDL_RenderPresent(renderer);
+	SDL_SetRenderTarget(renderer, canvas);
+
+	dirtyRects.reserve(MaxDirtyRects);
+	batchRects.reserve(RendererBatchSize);
+}
+
+void RendererTarget::batch(SDL_Rect const & rect, Color const & color)
+{
+	if (batchRects.size() == RendererBatchSize || (batchRects.size() && (color.r != batchColor.r || color.g != batchColor.g || color.b != batchColor.b)))
+		flush();
+
+	batchColor = color;
+	batchRects.pushBack(rect);
+}
+
+void RendererTarget::flush()
+{
+	if (!batchRects.size())
+		return;
+
+	SDL_SetRenderDrawColor(renderer, batchColor.r, batchColor.g, batchColor.b, 255);
+	SDL_RenderFillRects(renderer, batchRects.getData(), int(batchRects.size()));
+	batchRects.clear();
+}
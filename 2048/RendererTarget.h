@@ -0,0 +1,64 @@
+#pragma once
+#include "Window.h"
+
+
+// fills of one color sent in a single call at most
+static size_t const RendererBatchSize = 64;
+
+
+// draws through SDL_Renderer into a target texture that keeps the frame between presents
+class RendererTarget : public RenderTarget
+{
+public:
+
+	RendererTarget(SDL_Renderer* renderer, WindowProperties const & prop);
+
+	~RendererTarget();
+
+
+	SDL_Surface* createSurface(Vec2u const& size) const override;
+
+
+	// the sprite is uploaded once and its texture kept in the surface's userdata
+	void draw(SDL_Surface* sprite, Transform const& transform) override;
+
+	void drawPixel(Vec2i const& pos, Color const& color) override;
+
+	void drawLine(Vec2i const& start, Vec2i const& end, Color const& color) override;
+
+	void fillRect(Vec2i const& pos, Vec2i const& size, Color const& color) override;
+
+
+	void setClip(Vec2i const& pos, Vec2i const& size) override;
+
+protected:
+
+	void beginText(Color const& color, Vec2i const& glyphSize) override;
+
+	void drawGlyph(char c, SDL_Rect const& dest) override;
+
+
+	void clear(Color const& color) override;
+
+	void display() override;
+
+private:
+
+	// fills with the same color are sent as one SDL_RenderFillRects call
+	void batch(SDL_Rect const& rect, Color const& color);
+
+	void flush();
+
+private:
+
+	SDL_Renderer* renderer = nullptr;
+
+	SDL_Texture* canvas = nullptr;
+
+	SDL_Texture* charsetTexture = nullptr;
+
+
+	Vector<SDL_Rect> batchRects;
+
+	Color batchColor;
+};
@@ -0,0 +1,201 @@
+#include "ThumbnailCache.h"
+#include <stdio.h>
+
+#include "Board.h"
+#include "Window.h"
+
+
+ThumbnailCache::~ThumbnailCache()
+{
+	if (worker)
+	{
+		SDL_AtomicSet(&quitting, 1);
+		SDL_SemPost(signal);
+		SDL_WaitThread(worker, nullptr);
+
+		SDL_DestroySemaphore(signal);
+		SDL_DestroyMutex(mutex);
+	}
+
+	for (size_t i = 0; i < entries.size(); ++i)
+		RenderTarget::freeSurface(entries[i].surface);
+	for (size_t i = 0; i < finished.size(); ++i)
+		RenderTarget::freeSurface(finished[i].surface);
+}
+
+SDL_Surface * ThumbnailCache::get(size_t saveTime)
+{
+	collect();
+
+	size_t idx = lowerBound(saveTime);
+	if (idx < entries.size() && entries[idx].saveTime == saveTime)
+		return entries[idx].surface;
+
+	if (request(saveTime))
+	{
+		entries.pushBack({ saveTime, nullptr });
+		for (size_t i = entries.size() - 1; i > idx; --i)
+			swap(entries[i], entries[i - 1]);
+	}
+
+	return nullptr;
+}
+
+size_t ThumbnailCache::lowerBound(size_t saveTime) const
+{
+	size_t first = 0, last = entries.size();
+	while (first < last)
+	{
+		size_t mid = (first + last) / 2;
+		if (entries[mid].saveTime < saveTime)
+			first = mid + 1;
+		else
+			last = mid;
+	}
+	return first;
+}
+
+void ThumbnailCache::collect()
+{
+	if (!mutex || SDL_TryLockMutex(mutex) != 0)
+		return;
+
+	for (size_t i = 0; i < finished.size(); ++i)
+	{
+		size_t idx = lowerBound(finished[i].saveTime);
+		if (idx < entries.size() && entries[idx].saveTime == finished[i].saveTime)
+			entries[idx].surface = finished[i].surface;
+	}
+	requested -= finished.size();
+	finished.clear();
+
+	SDL_UnlockMutex(mutex);
+}
+
+bool ThumbnailCache::request(size_t saveTime)
+{
+	if (!worker)
+	{
+		mutex = SDL_CreateMutex();
+		signal = SDL_CreateSemaphore(0);
+		worker = SDL_CreateThread(workerMain, "thumbnails", this);
+	}
+
+	if (!worker || SDL_TryLockMutex(mutex) != 0)
+		return false;
+
+	pending.pushBack(saveTime);
+	++requested;
+
+	SDL_UnlockMutex(mutex);
+	SDL_SemPost(signal);
+	return true;
+}
+
+void ThumbnailCache::work()
+{
+	char savePath[32];
+	char thumbnailPath[48];
+
+	while (SDL_SemWait(signal) == 0 && !SDL_AtomicGet(&quitting))
+	{
+		SDL_LockMutex(mutex);
+		size_t saveTime = pending[pendingRead++];
+		if (pendingRead == pending.size())
+		{
+			pending.clear();
+			pendingRead = 0;
+		}
+		SDL_UnlockMutex(mutex);
+
+		sprintf_s(savePath, "%u", saveTime);
+		sprintf_s(thumbnailPath, "%u.thumb", saveTime);
+
+		SDL_Surface* surface = SDL_LoadBMP(thumbnailPath);
+		if (!surface && (surface = render(savePath)))
+			SDL_SaveBMP(surface, thumbnailPath);
+
+		SDL_LockMutex(mutex);
+		finished.pushBack({ saveTime, surface });
+		SDL_UnlockMutex(mutex);
+	}
+}
+
+int ThumbnailCache::workerMain(void * cache)
+{
+	((ThumbnailCache*)cache)->work();
+	return 0;
+}
+
+SDL_Surface * ThumbnailCache::render(char const * savePath)
+{
+	FILE* file = nullptr;
+	fopen_s(&file, savePath, "r");
+
+	if (!file)
+		return nullptr;
+
+	// same format as Board::saveTo, walls are stored as -1
+	Vector<int32_t> cells;
+	Vec2u size;
+	uint32_t columns = 0;
+	int32_t value = 0;
+	bool inToken = false;
+
+	for (int c = fgetc(file);; c = fgetc(file))
+	{
+		if (c >= '0' && c <= '9')
+		{
+			value = value * 10 + (c - '0');
+			inToken = true;
+			continue;
+		}
+		if (c == WallCharacter)
+		{
+			value = -1;
+			inToken = true;
+			continue;
+		}
+
+		if (inToken)
+		{
+			cells.pushBack(value);
+			value = 0;
+			inToken = false;
+			++columns;
+		}
+		if ((c == '\n' || c == EOF) && columns)
+		{
+			size.x = maxVal(size.x, columns);
+			++size.y;
+			columns = 0;
+		}
+		if (c == EOF)
+			break;
+	}
+	fclose(file);
+
+	if (!cells.size() || cells.size() != size.x * size.y)
+		return nullptr;
+
+	uint32_t cellSize = maxVal(1u, ThumbnailSize / maxVal(size.x, size.y));
+	uint32_t gap = cellSize >= 4 ? 1 : 0;
+
+	SDL_Surface* surface = SDL_CreateRGBSurface(0, cellSize * size.x, cellSize * size.y, 32, 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
+	if (!surface)
+		return nullptr;
+
+	SDL_FillRect(surface, NULL, Palette::get(PaletteBackground).sdlLike(surface));
+
+	SDL_Rect rect;
+	rect.w = rect.h = cellSize - gap;
+	for (uint32_t i = 0; i < size.y; ++i)
+		for (uint32_t j = 0; j < size.x; ++j)
+		{
+			rect.x = j * cellSize;
+			rect.y = i * cellSize;
+			SDL_FillRect(surface, &rect, Board::summaryColor(cells[i * size.x + j]).sdlLike(surface));
+		}
+
+	return surface;
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include "SDL-2.0.7/include/SDL.h"
+#include "Utility.h"
+
+
+static uint32_t const ThumbnailSize = 24;
+
+
+
+// renders previews of saved boards on a worker thread, get() never waits for it
+class ThumbnailCache
+{
+	struct Entry
+	{
+		size_t saveTime = 0;
+
+		SDL_Surface* surface = nullptr;
+	};
+
+public:
+
+	ThumbnailCache() = default;
+
+	ThumbnailCache(ThumbnailCache const&) = delete;
+
+	ThumbnailCache& operator=(ThumbnailCache const&) = delete;
+
+	~ThumbnailCache();
+
+
+	// returns nullptr until the thumbnail of the save is ready
+	SDL_Surface* get(size_t saveTime);
+
+	bool hasPending() const { return requested > 0; }
+
+private:
+
+	// index of the first entry not older than saveTime
+	size_t lowerBound(size_t saveTime) const;
+
+	void collect();
+
+	bool request(size_t saveTime);
+
+
+	void work();
+
+	static int workerMain(void* cache);
+
+	static SDL_Surface* render(char const* savePath);
+
+private:
+
+	// owned by the main thread, sorted by save time
+	Vector<Entry> entries;
+
+	size_t requested = 0;
+
+
+	// guarded by the mutex
+	Vector<size_t> pending;
+
+	size_t pendingRead = 0;
+
+	Vector<Entry> finished;
+
+
+	SDL_mutex* mutex = nullptr;
+
+	SDL_sem* signal = nullptr;
+
+	SDL_Thread* worker = nullptr;
+
+	SDL_atomic_t quitting = { 0 };
+};
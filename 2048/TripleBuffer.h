@@ -0,0 +1,50 @@
+#pragma once
+#include "SDL-2.0.7/include/SDL_atomic.h"
+
+
+// hands the latest of a stream of values from one thread to another without locking,
+// the writer fills its buffer while the reader holds on to its own, the third one is passed between them
+template<class T>
+class TripleBuffer
+{
+	// set in the middle index while the reader hasn't taken the value
+	static int const FreshBit = 4;
+
+public:
+
+	// the writer's buffer, it keeps whatever was in it two or more publishes ago
+	T& getBack() { return buffers[back]; }
+
+	void publish()
+	{
+		SDL_MemoryBarrierRelease();
+		back = SDL_AtomicSet(&middle, back | FreshBit) & ~FreshBit;
+		SDL_MemoryBarrierAcquire();
+	}
+
+
+	// returns false and keeps the buffer it had if nothing was published since the last call
+	bool acquire()
+	{
+		if (!(SDL_AtomicGet(&middle) & FreshBit))
+			return false;
+
+		// the buffer given back is done with, the one taken is read only after the swap
+		SDL_MemoryBarrierRelease();
+		front = SDL_AtomicSet(&middle, front) & ~FreshBit;
+		SDL_MemoryBarrierAcquire();
+		return true;
+	}
+
+	T const& getFront() const { return buffers[front]; }
+
+private:
+
+	T buffers[3];
+
+	int back = 0;
+
+	int front = 1;
+
+	SDL_atomic_t middle = { 2 };
+};
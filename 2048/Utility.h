@@ -4,10 +4,17 @@
 #include <stdlib.h>
 #include <stdio.h>
 
+// no entry of the palette
+static uint8_t const NoPaletteEntry = 0xff;
+
+
 struct Color
 {
 	uint8_t r = 255, g = 255, b = 255;
 
+	// set by Palette::get
+	uint8_t paletteEntry = NoPaletteEntry;
+
 	int sdlLike(struct SDL_Surface const* screen) const;
 
 	static Color const Red;
@@ -93,6 +100,10 @@ public:
 	template<class Cmp_t>
 	bool find(T const& other, Cmp_t cmp);
 
+	// stable merge sort, cmp(left, right) returns true if left goes first
+	template<class Cmp_t>
+	void sort(Cmp_t cmp);
+
 
 	T& front();
 
@@ -119,10 +130,10 @@ private:
 	static size_t const growth = 2;
 };
 
+// the memory is allocated with the first element
 template<class T>
 inline Vector<T>::Vector()
 {
-	reserve(16);
 }
 
 template<class T>
@@ -192,6 +203,10 @@ inline T const & Vector<T>::back() const
 template<class T>
 inline bool Vector<T>::reserve(size_t n)
 {
+	// never shrinks, so clearing and refilling reuses the memory
+	if (n <= reserved)
+		return true;
+
 	reserved = n;
 	T* newData = new T[n];
 	n = count < n ? count : n;
@@ -249,55 +264,6 @@ inline T const & Vector<T>::operator[](size_t idx) const
 }
 
 
-//static void merge(char const ** arr, int32_t l, int32_t m, int32_t r)
-//{
-//	int32_t lLen = m - l + 1;
-//	int32_t rLen = r - m;
-//	int32_t lIdx = 0, rIdx = 0, oIdx = l; // oIdx - index of arr
-//	char const ** lCpy = (char const **)malloc(lLen * sizeof(char*));
-//	char const ** rCpy = (char const **)malloc(rLen * sizeof(char*));
-//
-//
-//	for (lIdx = 0; lIdx < lLen; lIdx++)
-//		lCpy[lIdx] = arr[l + lIdx];
-//	for (rIdx = 0; rIdx < rLen; rIdx++)
-//		rCpy[rIdx] = arr[m + rIdx + 1];
-//
-//	for (oIdx = l, lIdx = 0, rIdx = 0; lIdx < lLen && rIdx < rLen; ++oIdx)
-//		if (strcmp(lCpy[lIdx], rCpy[rIdx]) <= 0)
-//			arr[oIdx] = lCpy[lIdx++];
-//		else
-//			arr[oIdx] = rCpy[rIdx++];
-//
-//	while (lIdx < lLen)
-//		arr[oIdx++] = lCpy[lIdx++];
-//	while (rIdx < rLen)
-//		arr[oIdx++] = rCpy[rIdx++];
-//
-//	free(lCpy);
-//	free(rCpy);
-//}
-//
-//static void mergeSort(char const** arr, int32_t l, int32_t r)
-//{
-//	if (l < r)
-//	{
-//		int m = l + (r - l) / 2;
-//
-//		mergeSort(arr, l, m);
-//		mergeSort(arr, m + 1, r);
-//
-//		merge(arr, l, m, r);
-//	}
-//}
-//
-//
-//void Vector::sort()
-//{
-//	if (data && count)
-//		mergeSort((char const**)data, 0, count - 1);
-//}
-
 template<class T>
 template<class Cmp_t>
 inline bool Vector<T>::find(T const & other, Cmp_t cmp)
@@ -307,3 +273,33 @@ inline bool Vector<T>::find(T const & other, Cmp_t cmp)
 			return true;
 	return false;
 }
+
+template<class T>
+template<class Cmp_t>
+inline void Vector<T>::sort(Cmp_t cmp)
+{
+	if (count < 2)
+		return;
+
+	T* temp = new T[reserved];
+
+	for (size_t width = 1; width < count; width *= 2)
+	{
+		for (size_t left = 0; left < count; left += 2 * width)
+		{
+			size_t mid = minVal(left + width, count);
+			size_t right = minVal(left + 2 * width, count);
+			size_t lIdx = left, rIdx = mid, oIdx = left;
+
+			while (lIdx < mid && rIdx < right)
+				temp[oIdx++] = cmp(data[rIdx], data[lIdx]) ? data[rIdx++] : data[lIdx++];
+			while (lIdx < mid)
+				temp[oIdx++] = data[lIdx++];
+			while (rIdx < right)
+				temp[oIdx++] = data[rIdx++];
+		}
+		swap(data, temp);
+	}
+
+	delete[] temp;
+}
\ No newline at end of file
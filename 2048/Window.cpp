@@ -4,38 +4,36 @@
 
 #include "Assert.h"
 #include "Application.h"
+#include "RendererTarget.h"
+#include "WorkerPool.h"
 
 
-RenderTarget::RenderTarget(SDL_Renderer* renderer, WindowProperties const & prop) : renderer(renderer)
+// sides of the clipping rectangle a point lies beyond
+enum : uint8_t { Left = 1, Right = 2, Top = 4, Bottom = 8 };
+
+static uint8_t outcode(Vec2i const& p, Vec2i const& min, Vec2i const& max)
 {
-	screen = SDL_CreateRGBSurface(0, prop.size.x, prop.size.y, 32, 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
-	scrtex = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, prop.size.x, prop.size.y);
+	return uint8_t((p.x < min.x ? Left : p.x > max.x ? Right : 0) | (p.y < min.y ? Top : p.y > max.y ? Bottom : 0));
+}
+
 
-	ASSERT((charset = SDL_LoadBMP("./cs8x8.bmp")), "SDL_ERROR: Charset loading");
-	SDL_SetColorKey(charset, true, 0x000000);
+
+RenderTarget::RenderTarget(Vec2i const & size, GlyphAtlas * glyphs, bool ownsGlyphs) : size(size), glyphs(glyphs), ownsGlyphs(ownsGlyphs)
+{
+	clip = { 0, 0, size.x, size.y };
 }
 
 RenderTarget::~RenderTarget()
 {
-	SDL_FreeSurface(charset);
-	SDL_FreeSurface(screen);
-	SDL_DestroyTexture(scrtex);
+	if (ownsGlyphs)
+		delete glyphs;
 }
 
-void RenderTarget::draw(SDL_Surface * sprite, Transform const& transform)
+void RenderTarget::freeSurface(SDL_Surface * surface)
 {
-	if (sprite)
-	{
-		Vec2i realSize(int32_t(sprite->w * transform.scale.x), int32_t(sprite->h * transform.scale.y));
-		SDL_Rect dest;
-
-		dest.x = int(transform.pos.x - realSize.x * transform.origin.x);
-		dest.y = int(transform.pos.y - realSize.y * transform.origin.y);
-		dest.w = realSize.x;
-		dest.h = realSize.y;
-
-		SDL_BlitScaled(sprite, NULL, screen, &dest);
-	}
+	if (surface && surface->userdata)
+		SDL_DestroyTexture((SDL_Texture*)surface->userdata);
+	SDL_FreeSurface(surface);
 }
 
 void RenderTarget::draw(char const * str, Color const & color, Transform transform)
@@ -44,15 +42,15 @@ void RenderTarget::draw(char const * str, Color const & color, Transform transfo
 		return;
 
 
-	SDL_Rect s, d;
-	s.w = 8;
-	s.h = 8;
-	d.w = int(8 * transform.scale.x);
-	d.h = int(8 * transform.scale.y);
+	SDL_Rect d;
+	d.w = int(CharsetGlyphSize * transform.scale.x);
+	d.h = int(CharsetGlyphSize * transform.scale.y);
 
 	Vec2i realSize(strlen(str) * d.w, d.h);
 	Vec2i startPos = transform.pos;
 
+	beginText(color, { d.w, d.h });
+
 	while (*str) 
 	{
 		int c = *str & 255;
@@ -64,64 +62,416 @@ void RenderTarget::draw(char const * str, Color const & color, Transform transfo
 			continue;
 		}
 
-		s.x = (c % 16) * 8;
-		s.y = (c / 16) * 8;
-
-
 		d.x = int32_t(transform.pos.x - realSize.x * transform.origin.x);
 		d.y = int32_t(transform.pos.y - realSize.y * transform.origin.y);
 
-		SDL_SetSurfaceColorMod(charset, color.r, color.g, color.b);
-		SDL_BlitScaled(charset, &s, screen, &d);
-
-
-		d.w = int(8 * transform.scale.x);
-		d.h = int(8 * transform.scale.y);
+		drawGlyph(char(c), d);
 
 		transform.pos.x += d.w;
 		str++;
 	};
 }
 
-void RenderTarget::drawPixel(Vec2i const & pos, Color const & color)
+void RenderTarget::invalidate(Vec2i const & pos, Vec2i const & size)
+{
+	SDL_Rect rect;
+	rect.x = maxVal(pos.x, 0);
+	rect.y = maxVal(pos.y, 0);
+	rect.w = minVal(pos.x + size.x, this->size.x) - rect.x;
+	rect.h = minVal(pos.y + size.y, this->size.y) - rect.y;
+
+	if (rect.w <= 0 || rect.h <= 0)
+		return;
+
+	if (dirtyRects.size() < MaxDirtyRects)
+		dirtyRects.pushBack(rect);
+	else
+	{
+		SDL_Rect& bounds = dirtyRects.front();
+		for (size_t i = 1; i < dirtyRects.size(); ++i)
+			SDL_UnionRect(&bounds, &dirtyRects[i], &bounds);
+		SDL_UnionRect(&bounds, &rect, &bounds);
+		dirtyRects.resize(1);
+	}
+}
+
+void RenderTarget::invalidate()
+{
+	invalidate({ 0, 0 }, size);
+}
+
+void RenderTarget::setClip(Vec2i const & pos, Vec2i const & size)
+{
+	SDL_Rect bounds = { 0, 0, this->size.x, this->size.y }, rect = { pos.x, pos.y, size.x, size.y };
+	if (!SDL_IntersectRect(&bounds, &rect, &clip))
+		clip = { 0, 0, 0, 0 };
+}
+
+void RenderTarget::resetClip()
+{
+	setClip({ 0, 0 }, size);
+}
+
+void RenderTarget::mapPalette(SDL_PixelFormat const * format)
+{
+	if (mappedFormat && format && mappedFormat->format == format->format)
+	{
+		mappedFormat = format;
+		return;
+	}
+
+	mappedFormat = format;
+	if (!format)
+		return;
+
+	for (uint8_t i = 0; i < PaletteSize; ++i)
+	{
+		Color color = Palette::get(i);
+		mappedPalette[i] = SDL_MapRGB(format, color.r, color.g, color.b);
+	}
+}
+
+Uint32 RenderTarget::mapColor(Color const & color) const
+{
+	if (color.paletteEntry < PaletteSize)
+		return mappedPalette[color.paletteEntry];
+	return SDL_MapRGB(mappedFormat, color.r, color.g, color.b);
+}
+
+void RenderTarget::drawSprites(SpriteBlit const * blits, size_t count)
+{
+	for (size_t i = 0; i < count; ++i)
+		draw(blits[i].sprite, Transform(blits[i].pos, {}, { 1.f, 1.f }));
+}
+
+bool RenderTarget::clipLine(Vec2i & start, Vec2i & end, Vec2i const & min, Vec2i const & max)
+{
+	uint8_t codeStart = outcode(start, min, max), codeEnd = outcode(end, min, max);
+
+	while (codeStart | codeEnd)
+	{
+		if (codeStart & codeEnd)
+			return false;
+
+		uint8_t code = codeStart ? codeStart : codeEnd;
+		Vec2i& p = codeStart ? start : end;
+
+		// the line can't be parallel to the crossed edge, so the divisions are safe
+		int64_t dx = end.x - start.x, dy = end.y - start.y;
+		if (code & (Top | Bottom))
+		{
+			int32_t y = (code & Top) ? min.y : max.y;
+			p = Vec2i(start.x + int32_t(dx * (y - start.y) / dy), y);
+		}
+		else
+		{
+			int32_t x = (code & Left) ? min.x : max.x;
+			p = Vec2i(x, start.y + int32_t(dy * (x - start.x) / dx));
+		}
+
+		if (&p == &start)
+			codeStart = outcode(start, min, max);
+		else
+			codeEnd = outcode(end, min, max);
+	}
+	return true;
+}
+
+
+
+
+SurfaceTarget::SurfaceTarget(SDL_Renderer* renderer, WindowProperties const & prop) : RenderTarget(Vec2i(prop.size), new GlyphAtlas(), true), renderer(renderer)
+{
+	scrtex = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, prop.size.x, prop.size.y);
+
+	locked = prop.backend == RenderBackend::LockedSurface;
+	if (locked)
+		lockScreen();
+	else
+		screen = SDL_CreateRGBSurface(0, prop.size.x, prop.size.y, 32, 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
+
+	mapPalette(screen->format);
+	dirtyRects.reserve(MaxDirtyRects);
+}
+
+SurfaceTarget::SurfaceTarget(SDL_Surface * surface, RenderTarget const & parent) : RenderTarget(Vec2i(surface->w, surface->h), parent.getGlyphs()), screen(surface), ownsSurfaces(false)
+{
+	mapPalette(screen->format);
+}
+
+SurfaceTarget::~SurfaceTarget()
+{
+	if (ownsSurfaces)
+	{
+		if (locked)
+			SDL_UnlockTexture(scrtex);
+		SDL_FreeSurface(screen);
+		SDL_DestroyTexture(scrtex);
+	}
+	delete rasterPool;
+}
+
+SDL_Surface * SurfaceTarget::createSurface(Vec2u const & size) const
+{
+	SDL_PixelFormat const* format = screen->format;
+	return SDL_CreateRGBSurface(0, size.x, size.y, format->BitsPerPixel, format->Rmask, format->Gmask, format->Bmask, format->Amask);
+}
+
+void SurfaceTarget::draw(SDL_Surface * sprite, Transform const& transform)
+{
+	if (sprite)
+	{
+		Vec2i realSize(int32_t(sprite->w * transform.scale.x), int32_t(sprite->h * transform.scale.y));
+		SDL_Rect dest;
+
+		dest.x = int(transform.pos.x - realSize.x * transform.origin.x);
+		dest.y = int(transform.pos.y - realSize.y * transform.origin.y);
+		dest.w = realSize.x;
+		dest.h = realSize.y;
+
+		if (blitter.blit(sprite, { 0, 0, sprite->w, sprite->h }, screen, dest))
+			return;
+
+		if (realSize.x == sprite->w && realSize.y == sprite->h)
+			SDL_BlitSurface(sprite, NULL, screen, &dest);
+		else
+			SDL_BlitScaled(sprite, NULL, screen, &dest);
+	}
+}
+
+void SurfaceTarget::drawSprites(SpriteBlit const * blits, size_t count)
+{
+	if (count < ParallelBlitThreshold || SDL_GetCPUCount() < 2)
+	{
+		RenderTarget::drawSprites(blits, count);
+		return;
+	}
+
+	if (!rasterPool)
+		rasterPool = new WorkerPool(minVal(uint32_t(SDL_GetCPUCount()), MaxRasterThreads) - 1);
+
+	parallelBlits.clear();
+	serialBlits.clear();
+	for (size_t i = 0; i < count; ++i)
+		if (canCopy(blits[i].sprite))
+			parallelBlits.pushBack(blits[i]);
+		else
+			serialBlits.pushBack(blits[i]);
+
+	rasterPool->run(drawBand, this);
+
+	RenderTarget::drawSprites(serialBlits.getData(), serialBlits.size());
+}
+
+void SurfaceTarget::drawPixel(Vec2i const & pos, Color const & color)
 {
 	int bpp = screen->format->BytesPerPixel;
-	if (pos.x >= 0 && pos.y >= 0 && pos.x < int32_t(WinSize.x) && pos.y < int32_t(WinSize.y))
+	SDL_Point point = { pos.x, pos.y };
+	if (SDL_PointInRect(&point, &clip))
 	{
 		Uint8 *p = (Uint8 *)screen->pixels + pos.y * screen->pitch + pos.x * bpp;
-		*(Uint32 *)p = color.sdlLike(screen);
+		*(Uint32 *)p = mapColor(color);
 	}
 }
 
+void SurfaceTarget::drawLine(Vec2i const & start, Vec2i const & end, Color const & color)
+{
+	Vec2i a = start, b = end;
+	if (!clipLine(a, b, { clip.x, clip.y }, Vec2i(clip.x + clip.w - 1, clip.y + clip.h - 1)))
+		return;
 
+	// straight lines are one row or one column
+	if (a.x == b.x || a.y == b.y)
+	{
+		fillRect({ minVal(a.x, b.x), minVal(a.y, b.y) }, { abs(b.x - a.x) + 1, abs(b.y - a.y) + 1 }, color);
+		return;
+	}
+
+	// Bresenham, walking a pointer instead of computing every pixel address
+	Uint32 pixel = mapColor(color);
+	int32_t pitch = screen->pitch / sizeof(Uint32);
+	Uint32* p = (Uint32*)((Uint8*)screen->pixels + a.y * screen->pitch) + a.x;
+
+	int32_t dx = abs(b.x - a.x), dy = -abs(b.y - a.y);
+	int32_t stepX = a.x < b.x ? 1 : -1;
+	int32_t stepY = a.y < b.y ? pitch : -pitch;
+	int32_t err = dx + dy;
+
+	for (int32_t n = maxVal(dx, -dy); n >= 0; --n)
+	{
+		*p = pixel;
+
+		int32_t err2 = 2 * err;
+		if (err2 >= dy)
+		{
+			err += dy;
+			p += stepX;
+		}
+		if (err2 <= dx)
+		{
+			err += dx;
+			p += stepY;
+		}
+	}
+}
+
+void SurfaceTarget::fillRect(Vec2i const & pos, Vec2i const & size, Color const & color)
+{
+	SDL_Rect rect;
+	rect.x = maxVal(pos.x, clip.x);
+	rect.y = maxVal(pos.y, clip.y);
+	rect.w = minVal(pos.x + size.x, clip.x + clip.w) - rect.x;
+	rect.h = minVal(pos.y + size.y, clip.y + clip.h) - rect.y;
+
+	if (rect.w > 0 && rect.h > 0)
+		SDL_FillRect(screen, &rect, mapColor(color));
+}
 
+void SurfaceTarget::setClip(Vec2i const & pos, Vec2i const & size)
+{
+	RenderTarget::setClip(pos, size);
+	SDL_SetClipRect(screen, &clip);
+}
 
-void RenderTarget::clear(Color const& color)
+void SurfaceTarget::beginText(Color const & color, Vec2i const & glyphSize)
 {
-	SDL_FillRect(screen, NULL, color.sdlLike(screen));
+	textAtlas = glyphs ? glyphs->get(glyphSize, color) : nullptr;
+	textGlyphSize = glyphSize;
 }
 
-void RenderTarget::display()
+void SurfaceTarget::drawGlyph(char c, SDL_Rect const & dest)
 {
-	SDL_UpdateTexture(scrtex, NULL, screen->pixels, screen->pitch);
+	if (!textAtlas)
+		return;
+
+	// blitting writes the clipped rectangle back
+	SDL_Rect src = GlyphAtlas::glyphRect(c, textGlyphSize), d = dest;
+	if (!blitter.blit(textAtlas, src, screen, d))
+		SDL_BlitSurface(textAtlas, &src, screen, &d);
+}
+
+
+
+
+void SurfaceTarget::clear(Color const& color)
+{
+	SDL_FillRect(screen, NULL, mapColor(color));
+}
+
+void SurfaceTarget::display()
+{
+	if (!isDirty())
+		return;
+
+	if (locked)
+	{
+		dirtyRects.clear();
+
+		SDL_UnlockTexture(scrtex);
+		SDL_RenderCopy(renderer, scrtex, NULL, NULL);
+		SDL_RenderPresent(renderer);
+
+		lockScreen();
+		return;
+	}
+
+	int bpp = screen->format->BytesPerPixel;
+	for (size_t i = 0; i < dirtyRects.size(); ++i)
+	{
+		SDL_Rect const& rect = dirtyRects[i];
+		SDL_UpdateTexture(scrtex, &rect, (Uint8*)screen->pixels + rect.y * screen->pitch + rect.x * bpp, screen->pitch);
+	}
+	dirtyRects.clear();
+
 	//SDL_RenderClear(renderer);
 	SDL_RenderCopy(renderer, scrtex, NULL, NULL);
 	SDL_RenderPresent(renderer);
 }
 
+void SurfaceTarget::lockScreen()
+{
+	void* pixels = nullptr;
+	int pitch = 0;
+
+	if (!SDL_LockTexture(scrtex, NULL, &pixels, &pitch))
+	{
+		// the memory can move between locks, the surface only follows it
+		if (screen && screen->pitch == pitch)
+		{
+			screen->pixels = pixels;
+			return;
+		}
+
+		SDL_FreeSurface(screen);
+		if ((screen = SDL_CreateRGBSurfaceFrom(pixels, size.x, size.y, 32, pitch, 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000)))
+		{
+			SDL_SetClipRect(screen, &clip);
+			mapPalette(screen->format);
+			return;
+		}
+		SDL_UnlockTexture(scrtex);
+	}
+
+	// the texture can't be drawn into, so the frame is kept and uploaded like without locking
+	SDL_FreeSurface(screen);
+	screen = SDL_CreateRGBSurface(0, size.x, size.y, 32, 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
+	SDL_SetClipRect(screen, &clip);
+	mapPalette(screen->format);
+	locked = false;
+	invalidate();
+}
+
+bool SurfaceTarget::canCopy(SDL_Surface * sprite) const
+{
+	if (!sprite || sprite->format->format != screen->format->format || screen->format->BytesPerPixel != 4)
+		return false;
+
+	SDL_BlendMode mode = SDL_BLENDMODE_BLEND;
+	Uint32 key = 0;
+	return !SDL_GetSurfaceBlendMode(sprite, &mode) && mode == SDL_BLENDMODE_NONE && SDL_GetColorKey(sprite, &key) < 0;
+}
+
+void SurfaceTarget::copySprite(SDL_Surface * screen, SpriteBlit const & blit, int32_t bandTop, int32_t bandBottom)
+{
+	SDL_Surface* sprite = blit.sprite;
+
+	SDL_Rect const& clip = screen->clip_rect;
+
+	int32_t left = maxVal(blit.pos.x, clip.x);
+	int32_t right = minVal(blit.pos.x + sprite->w, clip.x + clip.w);
+	int32_t top = maxVal(blit.pos.y, maxVal(bandTop, clip.y));
+	int32_t bottom = minVal(blit.pos.y + sprite->h, minVal(bandBottom, clip.y + clip.h));
+
+	if (left >= right || top >= bottom)
+		return;
+
+	size_t rowSize = size_t(right - left) * 4;
+	Uint8 const* src = (Uint8 const*)sprite->pixels + (top - blit.pos.y) * sprite->pitch + (left - blit.pos.x) * 4;
+	Uint8* dest = (Uint8*)screen->pixels + top * screen->pitch + left * 4;
+
+	for (int32_t y = top; y < bottom; ++y, src += sprite->pitch, dest += screen->pitch)
+		memcpy(dest, src, rowSize);
+}
+
+void SurfaceTarget::drawBand(void * target, uint32_t band, uint32_t bandCount)
+{
+	SurfaceTarget const& self = *(SurfaceTarget const*)target;
+
+	int32_t bandTop = int32_t(self.screen->h * band / bandCount);
+	int32_t bandBottom = int32_t(self.screen->h * (band + 1) / bandCount);
+
+	for (size_t i = 0; i < self.parallelBlits.size(); ++i)
+		copySprite(self.screen, self.parallelBlits[i], bandTop, bandBottom);
+}
+
 
 
 
 Window::Window(WindowProperties const & prop) : properties(prop)
 {
 	ASSERT(!SDL_Init(SDL_INIT_EVERYTHING), "SDL_ERROR: Init");
-	ASSERT(!SDL_CreateWindowAndRenderer(prop.size.x, prop.size.y, prop.flags, &window, &renderer), "SDL_ERROR: Window creation");
-
-	SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "linear");
-	SDL_RenderSetLogicalSize(renderer, prop.size.x, prop.size.y);
-	SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
 
-	target = new RenderTarget(renderer, prop);
+	ASSERT((window = SDL_CreateWindow("", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, prop.size.x, prop.size.y, prop.flags)), "SDL_ERROR: Window creation");
 
 	setTitle(prop.title);
 	setCursorVisible(prop.cursorVisible);
@@ -129,32 +479,111 @@ Window::Window(WindowProperties const & prop) : properties(prop)
 
 Window::~Window()
 {
-	delete target;
-	SDL_DestroyRenderer(renderer);
+	destroyTarget();
 	SDL_DestroyWindow(window);
 	SDL_Quit();
 }
 
+void Window::createTarget()
+{
+	if (properties.renderDriver[0])
+		SDL_SetHint(SDL_HINT_RENDER_DRIVER, properties.renderDriver);
+
+	ASSERT((renderer = SDL_CreateRenderer(window, -1, 0)), "SDL_ERROR: Renderer creation");
+
+	SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "linear");
+	SDL_RenderSetLogicalSize(renderer, properties.size.x, properties.size.y);
+	SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+
+	// the renderer backend keeps the frame in a target texture, without one it falls back to the surface
+	if (properties.backend == RenderBackend::Renderer && SDL_RenderTargetSupported(renderer))
+		target = new RendererTarget(renderer, properties);
+	else
+	{
+		if (properties.backend == RenderBackend::Renderer)
+			properties.backend = RenderBackend::Surface;
+		target = new SurfaceTarget(renderer, properties);
+	}
+}
+
+void Window::destroyTarget()
+{
+	delete target;
+	target = nullptr;
+
+	if (renderer)
+		SDL_DestroyRenderer(renderer);
+	renderer = nullptr;
+}
+
 void Window::clear(Color const& color)
 {
 	target->clear(color);
 }
 
+void Window::clear(Color const & color, Vec2i const & pos, Vec2i const & size)
+{
+	target->fillRect(pos, size, color);
+}
+
 void Window::draw(Drawable const & drawable)
 {
 	drawable.draw(*target);
 }
 
+void Window::setClip(Vec2i const & pos, Vec2i const & size)
+{
+	target->setClip(pos, size);
+}
+
+void Window::resetClip()
+{
+	target->resetClip();
+}
+
 void Window::display()
 {
 	target->display();
 }
 
+void Window::invalidate(Vec2i const & pos, Vec2i const & size)
+{
+	target->invalidate(pos, size);
+}
+
+void Window::invalidate()
+{
+	target->invalidate();
+}
+
+bool Window::isDirty() const
+{
+	return target->isDirty();
+}
+
+bool Window::keepsFrame() const
+{
+	return target->keepsFrame();
+}
+
 bool Window::pollEvent(SDL_Event & event)
 {
 	return SDL_PollEvent(&event);
 }
 
+bool Window::waitEvent(SDL_Event & event, uint32_t timeout)
+{
+	return SDL_WaitEventTimeout(&event, int(timeout)) != 0;
+}
+
+uint32_t Window::getRefreshRate() const
+{
+	SDL_DisplayMode mode;
+	if (!SDL_GetWindowDisplayMode(window, &mode) && mode.refresh_rate > 0)
+		return uint32_t(mode.refresh_rate);
+	return DefaultFrameRate;
+}
+
 void Window::setTitle(char const * title)
 {
 	ASSERT((strlen(title) < sizeof(WindowProperties::title)), "setTitle_ERROR: Title lenght is too long");
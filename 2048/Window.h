@@ -2,6 +2,23 @@
 #include "sdl-2.0.7/include/SDL.h"
 #include "Vec2.h"
 #include "Drawable.h"
+#include "GlyphAtlas.h"
+#include "Palette.h"
+#include "Blitter.h"
+#include "Clock.h"
+
+
+// LockedSurface draws straight into the memory of the locked streaming texture
+enum class RenderBackend : uint8_t { Surface, LockedSurface, Renderer, Count };
+
+// past this many rectangles they are merged into their bounding box
+static size_t const MaxDirtyRects = 32;
+
+// fewer sprites are not worth waking the raster threads for
+static size_t const ParallelBlitThreshold = 256;
+
+static uint32_t const MaxRasterThreads = 8;
+
 
 
 struct WindowProperties
@@ -10,43 +27,203 @@ struct WindowProperties
 	char title[32];
 	SDL_WindowFlags flags = SDL_WindowFlags(0);
 	bool cursorVisible = true;
+	RenderBackend backend = RenderBackend::Surface;
+	// value of SDL_HINT_RENDER_DRIVER, empty for the default driver
+	char renderDriver[16] = { 0 };
 };
 
 
+
 class RenderTarget
 {
 	friend class Window;
+	friend class DisplayList;
 
 public:
 
-	RenderTarget(SDL_Renderer* renderer, WindowProperties const & prop);
+	// glyphs can be shared with other targets, a target that only records text needs none
+	RenderTarget(Vec2i const& size, GlyphAtlas* glyphs, bool ownsGlyphs = false);
+
+	RenderTarget(RenderTarget const&) = delete;
+
+	RenderTarget& operator=(RenderTarget const&) = delete;
+
+	virtual ~RenderTarget();
+
+
+	// frees the texture a backend might have attached to the surface too
+	static void freeSurface(SDL_Surface* surface);
 
-	~RenderTarget();
+	virtual SDL_Surface* createSurface(Vec2u const& size) const = 0;
 
 
-	void draw(SDL_Surface* sprite, Transform const& transform);
+	virtual void draw(SDL_Surface* sprite, Transform const& transform) = 0;
 
 	void draw(char const* str, Color const & color, Transform transform = Transform());
 
-	void drawPixel(Vec2i const& pos, Color const& color);
+	// sprites of a batch must not overlap, so they can be drawn in any order
+	virtual void drawSprites(SpriteBlit const* blits, size_t count);
+
+	virtual void drawPixel(Vec2i const& pos, Color const& color) = 0;
+
+	// both ends are drawn
+	virtual void drawLine(Vec2i const& start, Vec2i const& end, Color const& color) = 0;
+
+	// clipped once, then filled row by row
+	virtual void fillRect(Vec2i const& pos, Vec2i const& size, Color const& color) = 0;
+
+
+	// nothing outside the rectangle is drawn until the clip is reset
+	virtual void setClip(Vec2i const& pos, Vec2i const& size);
+
+	void resetClip();
+
+
+	// only invalidated regions are presented by display()
+	void invalidate(Vec2i const& pos, Vec2i const& size);
+
+	void invalidate();
+
+	bool isDirty() const { return dirtyRects.size() > 0; }
+
+	// false if everything has to be drawn again before every display
+	virtual bool keepsFrame() const { return true; }
+
+
+	// Cohen-Sutherland, moves the ends inside the rectangle, returns false if nothing is left
+	static bool clipLine(Vec2i& start, Vec2i& end, Vec2i const& min, Vec2i const& max);
+
+
+	Vec2i const& getSize() const { return size; }
+
+	GlyphAtlas* getGlyphs() const { return glyphs; }
+
+protected:
+
+	// converts the palette once, colors of the palette are then only looked up
+	void mapPalette(SDL_PixelFormat const* format);
+
+	Uint32 mapColor(Color const& color) const;
+
+	// every glyph drawn until the next call has the given size and color
+	virtual void beginText(Color const& color, Vec2i const& glyphSize) = 0;
+
+	virtual void drawGlyph(char c, SDL_Rect const& dest) = 0;
+
+
+	virtual void clear(Color const& color) = 0;
+
+	virtual void display() = 0;
+
+protected:
+
+	Vec2i size;
+
+	GlyphAtlas* glyphs = nullptr;
+
+	bool ownsGlyphs = false;
+
+	Vector<SDL_Rect> dirtyRects;
+
+	SDL_Rect clip;
+
+
+	SDL_PixelFormat const* mappedFormat = nullptr;
+
+	Uint32 mappedPalette[PaletteSize];
+};
+
+
+
+// draws on the CPU into a surface, which is uploaded to a streaming texture,
+// or wraps the locked texture itself, then there is no upload but the frame is lost on every display
+class SurfaceTarget : public RenderTarget
+{
+public:
+
+	SurfaceTarget(SDL_Renderer* renderer, WindowProperties const & prop);
+
+	// draws into a surface owned by the caller, text uses the glyphs of the parent
+	SurfaceTarget(SDL_Surface* surface, RenderTarget const& parent);
+
+	~SurfaceTarget();
+
+
+	// in the pixel format of the screen
+	SDL_Surface* createSurface(Vec2u const& size) const override;
+
+
+	// through the blitter, unless the sprite needs something only SDL can do
+	void draw(SDL_Surface* sprite, Transform const& transform) override;
+
+	// big batches of opaque sprites are copied by several threads, each into its own band of rows
+	void drawSprites(SpriteBlit const* blits, size_t count) override;
+
+	void drawPixel(Vec2i const& pos, Color const& color) override;
+
+	void drawLine(Vec2i const& start, Vec2i const& end, Color const& color) override;
+
+	void fillRect(Vec2i const& pos, Vec2i const& size, Color const& color) override;
+
+
+	// kept as the clip rectangle of the screen, which SDL and the blitter honor too
+	void setClip(Vec2i const& pos, Vec2i const& size) override;
+
+
+	bool keepsFrame() const override { return !locked; }
+
+protected:
+
+	void beginText(Color const& color, Vec2i const& glyphSize) override;
+
+	void drawGlyph(char c, SDL_Rect const& dest) override;
+
+
+	void clear(Color const& color) override;
+
+	void display() override;
 
 private:
 
-	void clear(Color const& color);
+	// points the screen at the texture memory, without it the screen becomes a surface of its own
+	void lockScreen();
 
-	void display();
+	// opaque and in the format of the screen, so a row can be copied as it is
+	bool canCopy(SDL_Surface* sprite) const;
+
+	// safe to run on any thread as long as the bands don't overlap
+	static void copySprite(SDL_Surface* screen, SpriteBlit const& blit, int32_t bandTop, int32_t bandBottom);
+
+	static void drawBand(void* target, uint32_t band, uint32_t bandCount);
 
 private:
 
 	SDL_Renderer* renderer = nullptr;
 	SDL_Surface* screen = nullptr;
-	SDL_Surface* charset = nullptr;
 	SDL_Texture* scrtex = nullptr;
+
+	SDL_Surface* textAtlas = nullptr;
+	Vec2i textGlyphSize;
+
+	bool ownsSurfaces = true;
+
+	bool locked = false;
+
+	Blitter blitter;
+
+	class WorkerPool* rasterPool = nullptr;
+
+	Vector<SpriteBlit> parallelBlits;
+
+	// sprites that can't be copied row by row, drawn after the parallel part
+	Vector<SpriteBlit> serialBlits;
 };
 
 
 
 
+// the window belongs to the thread that creates it and takes its events,
+// the renderer and the target to the thread that calls createTarget and draws
 class Window
 {
 public:
@@ -64,15 +241,42 @@ public:
 	~Window();
 
 
+	void createTarget();
+
+	void destroyTarget();
+
+
 	void clear(Color const& color = Color::Black);
 
+	void clear(Color const& color, Vec2i const& pos, Vec2i const& size);
+
 	void draw(Drawable const& drawable);
 
+	void setClip(Vec2i const& pos, Vec2i const& size);
+
+	void resetClip();
+
+	// presents only if something was invalidated since the last call
 	void display();
 
+
+	void invalidate(Vec2i const& pos, Vec2i const& size);
+
+	void invalidate();
+
+	bool isDirty() const;
+
+	bool keepsFrame() const;
+
 	
 	bool pollEvent(SDL_Event& event);
 
+	// false if no event came in time
+	bool waitEvent(SDL_Event& event, uint32_t timeout);
+
+	// of the display the window is on
+	uint32_t getRefreshRate() const;
+
 
 	void setTitle(char const * title);
 
@@ -0,0 +1,77 @@
+#include "WorkerPool.h"
+
+
+WorkerPool::WorkerPool(uint32_t threadCount)
+{
+	done = SDL_CreateSemaphore(0);
+
+	// the threads keep pointers to the workers, so they are all in place before the first starts
+	workers.resize(threadCount);
+	for (uint32_t i = 0; i < threadCount; ++i)
+	{
+		workers[i].pool = this;
+		workers[i].part = i + 1;
+		workers[i].start = SDL_CreateSemaphore(0);
+	}
+
+	// a worker whose thread didn't start is taken by the next try, the parts go to the running ones only
+	uint32_t started = 0;
+	for (uint32_t i = 0; i < threadCount; ++i)
+	{
+		workers[started].thread = SDL_CreateThread(workerMain, "raster", &workers[started]);
+		if (workers[started].thread)
+			++started;
+	}
+
+	// shrinking leaves the running workers where their threads point
+	for (uint32_t i = started; i < threadCount; ++i)
+		SDL_DestroySemaphore(workers[i].start);
+	workers.resize(started);
+}
+
+WorkerPool::~WorkerPool()
+{
+	SDL_AtomicSet(&quitting, 1);
+
+	for (size_t i = 0; i < workers.size(); ++i)
+		SDL_SemPost(workers[i].start);
+
+	for (size_t i = 0; i < workers.size(); ++i)
+	{
+		SDL_WaitThread(workers[i].thread, nullptr);
+		SDL_DestroySemaphore(workers[i].start);
+	}
+
+	SDL_DestroySemaphore(done);
+}
+
+void WorkerPool::run(Job_t job, void * data)
+{
+	this->job = job;
+	this->data = data;
+
+	for (size_t i = 0; i < workers.size(); ++i)
+		SDL_SemPost(workers[i].start);
+
+	job(data, 0, getPartCount());
+
+	for (size_t i = 0; i < workers.size(); ++i)
+		SDL_SemWait(done);
+}
+
+int WorkerPool::workerMain(void * worker)
+{
+	Worker& self = *(Worker*)worker;
+	WorkerPool& pool = *self.pool;
+
+	while (true)
+	{
+		SDL_SemWait(self.start);
+
+		if (SDL_AtomicGet(&pool.quitting))
+			return 0;
+
+		pool.job(pool.data, self.part, pool.getPartCount());
+		SDL_SemPost(pool.done);
+	}
+}
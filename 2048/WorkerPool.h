@@ -0,0 +1,55 @@
+#pragma once
+#include "SDL-2.0.7/include/SDL.h"
+#include "Utility.h"
+
+
+// runs one job split into parts, a part per thread, the calling thread takes the first one
+class WorkerPool
+{
+	struct Worker
+	{
+		class WorkerPool* pool = nullptr;
+
+		uint32_t part = 0;
+
+		SDL_sem* start = nullptr;
+
+		SDL_Thread* thread = nullptr;
+	};
+
+public:
+
+	using Job_t = void(*)(void* data, uint32_t part, uint32_t partCount);
+
+
+
+	explicit WorkerPool(uint32_t threadCount);
+
+	WorkerPool(WorkerPool const&) = delete;
+
+	WorkerPool& operator=(WorkerPool const&) = delete;
+
+	~WorkerPool();
+
+
+	// returns when every part is done
+	void run(Job_t job, void* data);
+
+	uint32_t getPartCount() const { return uint32_t(workers.size()) + 1; }
+
+private:
+
+	static int workerMain(void* worker);
+
+private:
+
+	Vector<Worker> workers;
+
+	SDL_sem* done = nullptr;
+
+	Job_t job = nullptr;
+
+	void* data = nullptr;
+
+	SDL_atomic_t quitting = { 0 };
+};
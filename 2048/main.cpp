@@ -4,8 +4,14 @@
 
 int main(int argc, char **argv)
 {
-	srand(size_t(time(NULL)));
-	Application app;
+	// -seed <n> plays the same spawns again, with -virtual-clock at the same times too
+	size_t seed = size_t(time(NULL));
+	for (int i = 1; i + 1 < argc; ++i)
+		if (!strcmp(argv[i], "-seed"))
+			seed = size_t(strtoul(argv[i + 1], nullptr, 10));
+
+	srand(seed);
+	Application app(argc, argv);
 
 	return app.run();
 }
\ No newline at end of file
@@ -0,0 +1,84 @@
+#include "Tests.h"
+#include "../2048/Application.h"
+#include "../2048/AllocationTracker.h"
+
+
+static uint32_t const TestMoves = 5000;
+
+// the vectors of the boards grow to their size within the first moves
+static uint32_t const WarmUpMoves = 100;
+
+
+
+static bool canMove(Board const& board)
+{
+	for (uint8_t i = 0; i < uint8_t(Direction::Count); ++i)
+		if (board.canShiftTo(Direction(i)))
+			return true;
+	return false;
+}
+
+// shifts with their spawns and resets, every step published into a snapshot and drawn from it like in the game,
+// random ones or those of the autoplay with the policy, returns the allocations made after the warm-up
+static uint32_t playMoves(Board& board, Board& snapshot, Board& view, Board& checkpoint, AutoPlayer* autoPlayer, AutoPolicy policy)
+{
+	uint32_t start = 0;
+
+	for (uint32_t moves = 0; moves < WarmUpMoves + TestMoves; )
+	{
+		if (moves == WarmUpMoves && !start)
+			start = AllocationTracker::getAllocationCount();
+
+		if (!canMove(board))
+			board.reset();
+
+		Direction direction = autoPlayer ? autoPlayer->chooseMove(board, policy) : Direction(rand() % uint8_t(Direction::Count));
+		if (board.shiftTo(direction) < 0)
+			continue;
+		++moves;
+
+		while (board.isAnimating())
+		{
+			if (board.update(SimulationStep))
+				board.addNewTile();
+
+			snapshot.copyStateFrom(board);
+			view.copyStateFrom(snapshot);
+		}
+
+		// what the journal copies under its lock
+		if (moves % CheckpointInterval == 0)
+			checkpoint = board;
+	}
+
+	return AllocationTracker::getAllocationCount() - start;
+}
+
+
+
+bool testAllocations()
+{
+#ifdef TRACK_ALLOCATIONS
+	bool passed = true;
+
+	// the random moves first, then the autoplay with every policy
+	for (uint8_t run = 0; run <= uint8_t(AutoPolicy::Count); ++run)
+	{
+		srand(1);
+
+		Board board, snapshot, view, checkpoint;
+		AutoPlayer autoPlayer;
+		AutoPolicy policy = AutoPolicy(run - 1);
+		uint32_t count = playMoves(board, snapshot, view, checkpoint, run ? &autoPlayer : nullptr, policy);
+
+		if (count)
+			printf("%u %s moves made %u heap allocations\n", TestMoves, run ? AutoPlayer::getPolicyName(policy) : "random", count);
+		passed = count == 0 && passed;
+	}
+
+	return passed;
+#else
+	printf("allocations are only counted with TRACK_ALLOCATIONS, as in the Debug configuration\n");
+	return true;
+#endif
+}
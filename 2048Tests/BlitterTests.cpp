@@ -0,0 +1,169 @@
+#include "Tests.h"
+#include "../2048/Blitter.h"
+#include <string.h>
+
+
+static Uint32 const TestKey = 0x00ff00ff;
+
+static int32_t const SourceSize = 13;
+
+static int32_t const TargetSize = 64;
+
+
+
+struct BlitCase
+{
+	char const* name;
+	bool srcAlpha;
+	SDL_BlendMode mode;
+	bool keyed;
+	Uint8 alphaMod;
+	int32_t scale;
+	// by the blitter, a scaled blit cut by the clip rect is always left to SDL
+	bool accepted;
+};
+
+static BlitCase const BlitCases[] =
+{
+	{ "copy", false, SDL_BLENDMODE_NONE, false, 255, 1, true },
+	{ "copy with alpha", true, SDL_BLENDMODE_NONE, false, 255, 1, true },
+	{ "color key", false, SDL_BLENDMODE_NONE, true, 255, 1, true },
+	{ "color key with alpha", true, SDL_BLENDMODE_NONE, true, 255, 1, true },
+	{ "per pixel alpha", true, SDL_BLENDMODE_BLEND, false, 255, 1, true },
+	{ "alpha mod", true, SDL_BLENDMODE_BLEND, false, 128, 1, false },
+	{ "alpha mod without alpha", false, SDL_BLENDMODE_BLEND, false, 200, 1, false },
+	{ "scaled copy", false, SDL_BLENDMODE_NONE, false, 255, 2, true },
+	{ "scaled color key", false, SDL_BLENDMODE_NONE, true, 255, 3, true },
+	{ "scaled per pixel alpha", true, SDL_BLENDMODE_BLEND, false, 255, 2, false },
+};
+
+// positions of the blit on the target, some of them cut by its edges
+static SDL_Point const BlitPositions[] = { { 3, 5 }, { -4, 7 }, { 58, -6 }, { 40, 59 } };
+
+
+
+static SDL_Surface* createSurface(int32_t size, bool alpha)
+{
+	return SDL_CreateRGBSurface(0, size, size, 32, 0x00FF0000, 0x0000FF00, 0x000000FF, alpha ? 0xFF000000 : 0);
+}
+
+// random colors, with enough opaque, transparent and keyed pixels for each of them to take its own path
+static void fillRandom(SDL_Surface* surface)
+{
+	Uint32 alphaMask = surface->format->Amask;
+	for (int32_t y = 0; y < surface->h; ++y)
+	{
+		Uint32* row = (Uint32*)((Uint8*)surface->pixels + y * surface->pitch);
+		for (int32_t x = 0; x < surface->w; ++x)
+		{
+			Uint32 pixel = (Uint32(rand()) << 16) ^ Uint32(rand());
+			int kind = rand() % 5;
+			if (kind == 0)
+				pixel |= 0xff000000;
+			else if (kind == 1)
+				pixel &= 0x00ffffff;
+			else if (kind == 2)
+				pixel = TestKey | (pixel & 0xff000000);
+
+			row[x] = alphaMask ? pixel : pixel & 0x00ffffff;
+		}
+	}
+}
+
+static void copyPixels(SDL_Surface* dst, SDL_Surface const* src)
+{
+	for (int32_t y = 0; y < src->h; ++y)
+		memcpy((Uint8*)dst->pixels + y * dst->pitch, (Uint8 const*)src->pixels + y * src->pitch, size_t(src->w) * 4);
+}
+
+static bool compare(BlitCase const& blitCase, SDL_Point const& pos, SDL_Surface* blitted, SDL_Surface* expected)
+{
+	for (int32_t y = 0; y < blitted->h; ++y)
+		for (int32_t x = 0; x < blitted->w; ++x)
+		{
+			Uint32 got = ((Uint32*)((Uint8*)blitted->pixels + y * blitted->pitch))[x];
+			Uint32 want = ((Uint32*)((Uint8*)expected->pixels + y * expected->pitch))[x];
+			if (got != want)
+			{
+				printf("%s at (%d, %d): pixel (%d, %d) is %08x, SDL gives %08x\n", blitCase.name, pos.x, pos.y, x, y, got, want);
+				return false;
+			}
+		}
+
+	return true;
+}
+
+static bool testCase(Blitter& blitter, BlitCase const& blitCase, bool clipped)
+{
+	SDL_Surface* src = createSurface(SourceSize, blitCase.srcAlpha);
+	SDL_Surface* blitted = createSurface(TargetSize, true);
+	SDL_Surface* expected = createSurface(TargetSize, true);
+
+	fillRandom(src);
+	SDL_SetSurfaceBlendMode(src, blitCase.mode);
+	SDL_SetSurfaceAlphaMod(src, blitCase.alphaMod);
+	if (blitCase.keyed)
+		SDL_SetColorKey(src, SDL_TRUE, TestKey);
+
+	// like the board drawn below the HUD
+	if (clipped)
+	{
+		SDL_Rect clip = { 0, 8, TargetSize, TargetSize - 8 };
+		SDL_SetClipRect(blitted, &clip);
+		SDL_SetClipRect(expected, &clip);
+	}
+
+	bool passed = true;
+	for (SDL_Point const& pos : BlitPositions)
+	{
+		int32_t size = SourceSize * blitCase.scale;
+
+		fillRandom(blitted);
+		copyPixels(expected, blitted);
+
+		SDL_Rect srcRect = { 0, 0, SourceSize, SourceSize };
+		SDL_Rect destRect = { pos.x, pos.y, size, size };
+
+		SDL_Rect visible;
+		bool cut = SDL_IntersectRect(&destRect, &blitted->clip_rect, &visible) && !SDL_RectEquals(&visible, &destRect);
+		bool accepted = blitCase.accepted && !(blitCase.scale > 1 && cut);
+
+		// anything the blitter refuses is drawn by SDL in the game too, so it only has to refuse the right ones
+		if (blitter.blit(src, srcRect, blitted, destRect) != accepted)
+		{
+			printf("%s at (%d, %d): the blitter %s it\n", blitCase.name, pos.x, pos.y, accepted ? "refused" : "took");
+			passed = false;
+			continue;
+		}
+		if (!accepted)
+			continue;
+
+		if (blitCase.scale > 1)
+			SDL_BlitScaled(src, &srcRect, expected, &destRect);
+		else
+			SDL_BlitSurface(src, &srcRect, expected, &destRect);
+
+		passed = compare(blitCase, pos, blitted, expected) && passed;
+	}
+
+	SDL_FreeSurface(expected);
+	SDL_FreeSurface(blitted);
+	SDL_FreeSurface(src);
+	return passed;
+}
+
+
+
+bool testBlitter()
+{
+	Blitter blitter;
+
+	bool passed = true;
+	for (BlitCase const& blitCase : BlitCases)
+	{
+		passed = testCase(blitter, blitCase, false) && passed;
+		passed = testCase(blitter, blitCase, true) && passed;
+	}
+
+	return passed;
+}
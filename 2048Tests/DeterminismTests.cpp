@@ -0,0 +1,63 @@
+#include "Tests.h"
+#include "../2048/Application.h"
+
+
+// the autoplay on a scripted virtual clock, quit long before a 4 by 4 board could fill up
+static char const* const Arguments[] =
+{
+	"2048", "-virtual-clock", "5", "-virtual-clock-script", "3,9,4,17", "-board-size", "4", "-autoplay", "-quit-after", "300"
+};
+
+static unsigned const Seed = 2048;
+
+
+
+struct RunResult
+{
+	size_t worldTime = 0;
+	uint32_t moveCount = 0;
+};
+
+static RunResult runGame()
+{
+	srand(Seed);
+
+	// the window belongs to the dummy video driver, nothing is shown and no event comes
+	Application* app = new Application(int(sizeof(Arguments) / sizeof(*Arguments)), const_cast<char**>(Arguments));
+	app->run();
+
+	RunResult result;
+	result.worldTime = app->getWorldTime();
+	result.moveCount = app->getMoveCount();
+	delete app;
+
+	return result;
+}
+
+bool testDeterminism()
+{
+	SDL_setenv("SDL_VIDEODRIVER", "dummy", 1);
+	SDL_setenv("SDL_AUDIODRIVER", "dummy", 1);
+
+	RunResult first = runGame();
+	RunResult second = runGame();
+
+	bool passed = true;
+	if (first.moveCount == 0)
+	{
+		printf("  the autoplay made no move\n");
+		passed = false;
+	}
+	if (first.worldTime != second.worldTime)
+	{
+		printf("  world time %u, then %u\n", unsigned(first.worldTime), unsigned(second.worldTime));
+		passed = false;
+	}
+	if (first.moveCount != second.moveCount)
+	{
+		printf("  %u moves, then %u\n", first.moveCount, second.moveCount);
+		passed = false;
+	}
+
+	return passed;
+}
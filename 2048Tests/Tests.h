@@ -0,0 +1,12 @@
+#pragma once
+#include <stdio.h>
+
+
+// each prints what went wrong and returns false, the rest of its cases still run
+bool testBlitter();
+
+// 5000 random moves of a game in progress and 5000 of the autoplay with each policy, in the Debug configuration
+bool testAllocations();
+
+// two autoplayed runs on the same virtual clock script end at the same world time after the same moves
+bool testDeterminism();
@@ -0,0 +1,31 @@
+#include "../2048/SDL-2.0.7/include/SDL.h"
+#include "Tests.h"
+
+
+struct Test
+{
+	char const* name;
+	bool(*run)();
+};
+
+static Test const Tests[] =
+{
+	{ "blitter", testBlitter },
+	{ "allocations", testAllocations },
+	{ "determinism", testDeterminism },
+};
+
+
+
+int main(int argc, char **argv)
+{
+	int failed = 0;
+	for (Test const& test : Tests)
+	{
+		bool passed = test.run();
+		printf("%s: %s\n", test.name, passed ? "passed" : "FAILED");
+		failed += passed ? 0 : 1;
+	}
+
+	return failed;
+}